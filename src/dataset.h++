@@ -0,0 +1,546 @@
+#ifndef DATASET_H
+#define DATASET_H
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "./matrix.h++"
+#include "./mapped_file.h++"
+
+
+/**
+ * NOTE: Dataset loading for training
+ *
+ * IDX files (MNIST) are memory mapped and their pixels are used in place, so loading is O(1)
+ * and datasets larger than RAM are paged in on demand. CSV files (IRIS) are parsed once into
+ * a single contiguous buffer. Either way samples are normalised on the fly
+ *
+ * BatchLoader shuffles, normalises and column stacks samples on a background thread into
+ * two alternating batches, so the next batch is ready while the network trains on the current one
+ */
+
+
+namespace dataset {
+
+    class Dataset {
+        private:
+        mapped::MappedFile featureFile;
+        mapped::MappedFile labelFile;
+
+        size_t count; //Samples
+        size_t features; //Values per sample
+        size_t classes; //Highest label + 1
+
+        //Exactly one of these holds the features, both are count x features (row major)
+        const uint8_t *bytes; //IDX, points into featureFile
+        std::vector<float> values; //CSV, owned
+
+        //Labels, one per sample
+        const uint8_t *labelBytes; //IDX, points into labelFile
+        std::vector<int> labels; //CSV, owned
+        std::vector<std::string> classNames; //CSV class names, index = label
+
+        //Normalised value = (raw - offset) * scale, per feature
+        std::vector<float> offset;
+        std::vector<float> scale;
+
+
+        static uint32_t read_big_endian(const uint8_t *in) {
+            return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+        }
+
+        void reset(void) {
+            this->featureFile.close();
+            this->labelFile.close();
+            this->count = 0;
+            this->features = 0;
+            this->classes = 0;
+            this->bytes = NULL;
+            this->labelBytes = NULL;
+            this->values.clear();
+            this->labels.clear();
+            this->classNames.clear();
+            this->offset.clear();
+            this->scale.clear();
+        }
+
+        public:
+        Dataset(void) {
+            this->reset();
+        }
+
+        Dataset(const Dataset &) = delete;
+        Dataset &operator=(const Dataset &) = delete;
+
+
+        /**
+         * @brief Map an IDX image file (magic 0x803) and its IDX label file (magic 0x801)
+         *
+         * Pixels stay in the mapping. Default normalisation is pixel / 255
+         *
+         * @param imageFile :: IDX file of uint8 samples
+         * @param labelFile :: IDX file of uint8 labels
+         * @param maxCount :: Use at most this many samples
+         *
+         * @return bool :: Indication of if both files were loaded
+         */
+        bool load_idx(std::string imageFile, std::string labelFile, size_t maxCount = SIZE_MAX) {
+            this->reset();
+            if(!this->featureFile.open(imageFile) || !this->labelFile.open(labelFile)) {
+                this->reset();
+                return false;
+            }
+
+            const uint8_t *img = this->featureFile.data();
+            const uint8_t *lab = this->labelFile.data();
+            if(this->featureFile.size() < 16 || this->labelFile.size() < 8 ||
+               read_big_endian(img) != 0x803 || read_big_endian(lab) != 0x801) {
+                this->reset();
+                return false;
+            }
+
+            size_t images = read_big_endian(img + 4);
+            size_t rows = read_big_endian(img + 8);
+            size_t cols = read_big_endian(img + 12);
+            size_t labelCount = read_big_endian(lab + 4);
+
+            //The header is untrusted, so sizes are compared by division and can never wrap
+            if(rows == 0 || cols == 0 || cols > SIZE_MAX / rows) {
+                this->reset();
+                return false;
+            }
+            this->features = rows * cols;
+            this->count = std::min(std::min(images, labelCount), maxCount);
+            if(this->count > (this->featureFile.size() - 16) / this->features ||
+               this->count > this->labelFile.size() - 8) {
+                this->reset();
+                return false;
+            }
+
+            this->bytes = img + 16;
+            this->labelBytes = lab + 8;
+            for(size_t i = 0; i < this->count; i++) {
+                this->classes = std::max(this->classes, (size_t)this->labelBytes[i] + 1);
+            }
+
+            this->offset.assign(this->features, 0.0f);
+            this->scale.assign(this->features, 1.0f / 255.0f);
+            return true;
+        }
+
+
+        /**
+         * @brief Parse a CSV file of numeric features with a class name in the last column
+         *
+         * Class names get labels in order of first appearance. Empty lines are skipped. No normalisation by default
+         * Fails on any feature that is not entirely a number (surrounding spaces allowed)
+         *
+         * @param fileName :: CSV file
+         * @param maxCount :: Use at most this many samples
+         *
+         * @return bool :: Indication of if the file was loaded
+         */
+        bool load_csv(std::string fileName, size_t maxCount = SIZE_MAX) {
+            this->reset();
+            if(!this->featureFile.open(fileName)) {
+                return false;
+            }
+
+            const char *text = (const char *)this->featureFile.data();
+            size_t size = this->featureFile.size();
+            std::map<std::string, int> classIds;
+            std::string field; //Whole field, names and numbers of any length
+
+            size_t pos = 0;
+            while(pos < size && this->count < maxCount) {
+                size_t end = pos;
+                while(end < size && text[end] != '\n') {
+                    end++;
+                }
+                size_t lineEnd = end;
+                if(lineEnd > pos && text[lineEnd - 1] == '\r') {
+                    lineEnd--;
+                }
+
+                if(lineEnd > pos) {
+                    size_t fieldsSeen = 0;
+                    size_t start = pos;
+                    while(1) {
+                        size_t stop = start;
+                        while(stop < lineEnd && text[stop] != ',') {
+                            stop++;
+                        }
+                        field.assign(text + start, stop - start);
+
+                        if(stop == lineEnd) { //Last column is the class name
+                            std::map<std::string, int>::iterator found = classIds.find(field);
+                            if(found == classIds.end()) {
+                                found = classIds.emplace(field, (int)this->classNames.size()).first;
+                                this->classNames.push_back(field);
+                            }
+                            this->labels.push_back(found->second);
+                            break;
+                        }
+
+                        //The whole field has to be a number, "5.1x" or "1e" is malformed
+                        while(!field.empty() && (field.back() == ' ' || field.back() == '\t')) {
+                            field.pop_back();
+                        }
+                        char *parsed = NULL;
+                        float val = std::strtof(field.c_str(), &parsed);
+                        if(parsed == field.c_str() || *parsed != '\0') {
+                            this->reset();
+                            return false;
+                        }
+                        this->values.push_back(val);
+                        fieldsSeen++;
+                        start = stop + 1;
+                    }
+
+                    if(this->count == 0) {
+                        this->features = fieldsSeen;
+                    }
+                    if(fieldsSeen != this->features || this->features == 0) {
+                        this->reset();
+                        return false;
+                    }
+                    this->count++;
+                }
+                pos = end + 1;
+            }
+
+            //Everything has been copied out of the mapping
+            this->featureFile.close();
+            if(this->count == 0) {
+                this->reset();
+                return false;
+            }
+
+            this->classes = this->classNames.size();
+            this->offset.assign(this->features, 0.0f);
+            this->scale.assign(this->features, 1.0f);
+            return true;
+        }
+
+
+        /**
+         * @brief Set per feature normalisation, value = (raw - offset) * scale
+         *
+         * @param offsets :: One offset per feature
+         * @param scales :: One scale per feature
+         *
+         * @return void :: None
+         */
+        void set_normalization(const std::vector<float> &offsets, const std::vector<float> &scales) {
+            if(offsets.size() != this->features || scales.size() != this->features) {
+                throw std::invalid_argument("Normalization needs one value per feature\n");
+            }
+            this->offset = offsets;
+            this->scale = scales;
+            return;
+        }
+
+
+        /**
+         * @brief Normalise every feature from the given [min, max] ranges to [0, 1]
+         *
+         * @param mins :: Minimum of each feature
+         * @param maxs :: Maximum of each feature
+         *
+         * @return void :: None
+         */
+        void set_min_max(const std::vector<float> &mins, const std::vector<float> &maxs) {
+            std::vector<float> scales(maxs.size());
+            for(size_t i = 0; i < scales.size() && i < mins.size(); i++) {
+                scales[i] = 1.0f / (maxs[i] - mins[i]);
+            }
+            this->set_normalization(mins, scales);
+            return;
+        }
+
+
+        /**
+         * @brief Write the normalised features of a sample
+         *
+         * @param i :: Sample index
+         * @param out :: Receives feature_count() values
+         * @param stride :: Distance between written values (1 for a vector, batch size for a matrix column)
+         *
+         * @return void :: None
+         */
+        void sample(size_t i, float *out, size_t stride = 1) const {
+            if(this->bytes) {
+                const uint8_t *src = this->bytes + i * this->features;
+                for(size_t k = 0; k < this->features; k++) {
+                    out[k * stride] = ((float)src[k] - this->offset[k]) * this->scale[k];
+                }
+            } else {
+                const float *src = this->values.data() + i * this->features;
+                for(size_t k = 0; k < this->features; k++) {
+                    out[k * stride] = (src[k] - this->offset[k]) * this->scale[k];
+                }
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Normalised features of a sample as a vector (allocates, prefer sample for hot loops)
+         *
+         * @param i :: Sample index
+         *
+         * @return std::vector<float> :: Features
+         */
+        std::vector<float> sample_vector(size_t i) const {
+            std::vector<float> out(this->features);
+            this->sample(i, out.data());
+            return out;
+        }
+
+
+        /**
+         * @brief Label of a sample
+         *
+         * @param i :: Sample index
+         *
+         * @return int :: Class index
+         */
+        int label(size_t i) const {
+            return this->labelBytes ? (int)this->labelBytes[i] : this->labels[i];
+        }
+
+        size_t size(void) const {
+            return this->count;
+        }
+
+        size_t feature_count(void) const {
+            return this->features;
+        }
+
+        size_t class_count(void) const {
+            return this->classes;
+        }
+
+        /**
+         * @brief Class names from a CSV file (empty for IDX)
+         *
+         * @return const std::vector<std::string>& :: Names, index = label
+         */
+        const std::vector<std::string> &class_names(void) const {
+            return this->classNames;
+        }
+    };
+
+
+    typedef struct Batch {
+        matrix::Matrix<float> x; //features x n, one sample per column
+        matrix::Matrix<float> y; //classes x n, one-hot
+        std::vector<int> labels; //n labels
+        size_t size; //n
+    } Batch;
+
+
+    class BatchLoader {
+        private:
+        typedef enum SLOT_STATE {
+            FREE,
+            READY,
+            END_OF_EPOCH,
+            IN_USE,
+        } SLOT_STATE;
+
+        const Dataset &data;
+        std::vector<size_t> order; //Samples this loader draws from, reshuffled every epoch
+        size_t batchSize;
+        bool shuffle;
+        std::mt19937 rng;
+
+        //Double buffer, the producer fills one slot while the consumer trains on the other
+        Batch slots[2];
+        SLOT_STATE states[2];
+        size_t consumerSlot;
+
+        std::thread producer;
+        std::mutex lock;
+        std::condition_variable changed;
+        bool stopping;
+
+
+        /**
+         * @brief Wait for a slot to be released, false if the loader is stopping
+         */
+        bool wait_free(size_t slot) {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->changed.wait(guard, [&](void) {
+                return this->stopping || this->states[slot] == FREE;
+            });
+            return !this->stopping;
+        }
+
+        void publish(size_t slot, SLOT_STATE state) {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->states[slot] = state;
+            }
+            this->changed.notify_all();
+        }
+
+
+        /**
+         * @brief Background thread. Fills slots alternately, one end of epoch marker per epoch
+         */
+        void produce(void) {
+            size_t slot = 0;
+            size_t features = this->data.feature_count();
+            size_t classes = this->data.class_count();
+
+            while(1) {
+                if(this->shuffle) {
+                    std::shuffle(this->order.begin(), this->order.end(), this->rng);
+                }
+
+                for(size_t start = 0; start < this->order.size(); start += this->batchSize) {
+                    if(!this->wait_free(slot)) {
+                        return;
+                    }
+
+                    Batch &batch = this->slots[slot];
+                    size_t n = std::min(this->batchSize, this->order.size() - start);
+                    batch.size = n;
+                    batch.x.resize(features, n);
+                    batch.y.resize(classes, n);
+                    batch.labels.resize(n);
+
+                    //Column j of a features x n row major matrix starts at j with stride n
+                    float *x = batch.x.get_data();
+                    float *y = batch.y.get_data();
+                    std::fill(y, y + classes * n, 0.0f);
+                    for(size_t j = 0; j < n; j++) {
+                        size_t idx = this->order[start + j];
+                        this->data.sample(idx, x + j, n);
+                        batch.labels[j] = this->data.label(idx);
+                        y[batch.labels[j] * n + j] = 1.0f;
+                    }
+
+                    this->publish(slot, READY);
+                    slot ^= 1;
+                }
+
+                if(!this->wait_free(slot)) {
+                    return;
+                }
+                this->publish(slot, END_OF_EPOCH);
+                slot ^= 1;
+            }
+        }
+
+        public:
+        /**
+         * @brief Start loading batches in the background
+         *
+         * @param data :: Dataset to draw from (must outlive the loader)
+         * @param indices :: Samples to use (e.g. a train split). Empty uses every sample
+         * @param batchSize :: Samples per batch. The last batch of an epoch may be smaller
+         * @param shuffle :: Reshuffle the samples every epoch
+         * @param seed :: Shuffle seed
+         */
+        BatchLoader(const Dataset &data, std::vector<size_t> indices, size_t batchSize,
+                    bool shuffle = true, unsigned int seed = std::random_device{}()) : data(data), rng(seed) {
+
+            if(batchSize == 0) {
+                throw std::invalid_argument("Batch size must be at least 1\n");
+            }
+
+            this->order = indices;
+            if(this->order.empty()) {
+                this->order.resize(data.size());
+                for(size_t i = 0; i < this->order.size(); i++) {
+                    this->order[i] = i;
+                }
+            }
+            if(this->order.empty()) {
+                throw std::invalid_argument("Dataset is empty\n");
+            }
+            for(size_t idx : this->order) {
+                if(idx >= data.size()) {
+                    throw std::out_of_range("Sample index past the end of the dataset\n");
+                }
+            }
+
+            this->batchSize = batchSize;
+            this->shuffle = shuffle;
+            this->states[0] = FREE;
+            this->states[1] = FREE;
+            this->consumerSlot = 0;
+            this->stopping = false;
+            this->producer = std::thread(&BatchLoader::produce, this);
+        }
+
+        BatchLoader(const BatchLoader &) = delete;
+        BatchLoader &operator=(const BatchLoader &) = delete;
+
+        ~BatchLoader() {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->changed.notify_all();
+            this->producer.join();
+        }
+
+
+        /**
+         * @brief Get the next batch. The batch returned by the previous call is handed back for refilling
+         *
+         * @return Batch* :: Next batch, or NULL at the end of an epoch (the following call starts the next epoch)
+         */
+        Batch *next(void) {
+            std::unique_lock<std::mutex> guard(this->lock);
+
+            //Release the batch the caller was using
+            size_t slot = this->consumerSlot;
+            if(this->states[slot] == IN_USE) {
+                this->states[slot] = FREE;
+                slot ^= 1;
+                this->consumerSlot = slot;
+                this->changed.notify_all();
+            }
+
+            this->changed.wait(guard, [&](void) {
+                return this->states[slot] == READY || this->states[slot] == END_OF_EPOCH;
+            });
+
+            if(this->states[slot] == END_OF_EPOCH) {
+                this->states[slot] = FREE;
+                this->consumerSlot = slot ^ 1;
+                this->changed.notify_all();
+                return NULL;
+            }
+
+            this->states[slot] = IN_USE;
+            return &this->slots[slot];
+        }
+
+
+        /**
+         * @brief Number of samples drawn per epoch
+         *
+         * @return size_t :: Samples
+         */
+        size_t size(void) const {
+            return this->order.size();
+        }
+    };
+}
+
+
+
+#endif
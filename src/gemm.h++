@@ -0,0 +1,790 @@
+#ifndef GEMM_H
+#define GEMM_H
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define GEMM_X86 1
+#endif
+
+
+/**
+ * NOTE: Single precision kernels behind matrix::Matrix<float>::multiply
+ * All matricies are row major with a leading dimension (distance between rows)
+ * C = alpha * op(A) * op(B) (+ C when accumulating) where op is either identity or transpose
+ *
+ * An optional epilogue finishes C while it is still in cache: it runs on each tile of C once the last
+ * K panel of that tile has been added (used to fuse bias + activation into the layer product)
+ *
+ * Large products are cache blocked (GotoBLAS style). Panels of op(A) and op(B) are
+ * packed into contiguous buffers, which also removes the transpose from the inner loop,
+ * then a register tiled micro kernel computes an MR x NR tile of C per call
+ *
+ * Matrix-vector shapes (batch size 1) skip packing and use dedicated kernels
+ *
+ * AVX2 and AVX-512 kernels are compiled with target attributes and selected at runtime,
+ * so no -march flag is needed. Other CPUs use the portable scalar kernels
+ */
+
+
+namespace gemm {
+
+    typedef enum ISA {
+        SCALAR,
+        AVX2,
+        AVX512,
+    } ISA;
+
+    //Cache blocking, in floats
+    //KC x NR panel of B stays in L1, MC x KC block of A in L2, KC x NC block of B in L3
+    const size_t KC = 256;
+    const size_t MC = 96;
+    const size_t NC = 2048;
+
+    //Below this many multiply-adds packing costs more than it saves
+    const size_t SMALL_PRODUCT = 16 * 16 * 16;
+
+    //Compute an MR x NR tile of C from packed panels. Accumulate adds to C instead of overwriting
+    typedef void (*MicroKernel)(size_t kc, const float *a, const float *b, float *c, size_t ldc, size_t mr, size_t nr, bool accumulate);
+    //y = A * x (transpose = false) or y = A^T * x (transpose = true), A is rows x cols
+    typedef void (*GemvKernel)(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y);
+
+    typedef struct Kernel {
+        ISA isa;
+        size_t mr;
+        size_t nr;
+        MicroKernel micro;
+        GemvKernel gemvN;
+        GemvKernel gemvT;
+    } Kernel;
+
+    //Finish a finished rows x cols block of C in place. rowData holds one value per row of the block,
+    //cellData one value per element of the block with the same leading dimension as C
+    typedef void (*EpilogueFn)(float *c, size_t ldc, size_t rows, size_t cols, const float *rowData, const float *cellData);
+
+    typedef struct Epilogue {
+        EpilogueFn apply;
+        const float *rowData;  //One value per row of C (e.g. a bias), NULL if unused
+        const float *cellData; //One value per element of C, laid out like C (e.g. activations), NULL if unused
+    } Epilogue;
+
+
+    /**
+     * @brief Write a computed tile into C, only touching the valid mr x nr corner
+     *
+     * @param tile :: Computed tile with a leading dimension of nrFull
+     * @param nrFull :: Leading dimension of the tile
+     * @param c :: Top left of the destination in C
+     * @param ldc :: Leading dimension of C
+     * @param mr :: Valid rows
+     * @param nr :: Valid cols
+     * @param accumulate :: Add to C instead of overwriting
+     *
+     * @return void :: None
+     */
+    inline void store_tile(const float *tile, size_t nrFull, float *c, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+        for(size_t i = 0; i < mr; i++) {
+            for(size_t j = 0; j < nr; j++) {
+                float val = tile[i * nrFull + j];
+                c[i * ldc + j] = accumulate ? c[i * ldc + j] + val : val;
+            }
+        }
+        return;
+    }
+
+
+    /* Scalar kernels */
+
+    inline void micro_scalar(size_t kc, const float *a, const float *b, float *c, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+        float acc[4 * 4] = {0};
+        for(size_t k = 0; k < kc; k++) {
+            for(size_t i = 0; i < 4; i++) {
+                float aVal = a[k * 4 + i];
+                for(size_t j = 0; j < 4; j++) {
+                    acc[i * 4 + j] += aVal * b[k * 4 + j];
+                }
+            }
+        }
+        store_tile(acc, 4, c, ldc, mr, nr, accumulate);
+        return;
+    }
+
+    inline void gemv_n_scalar(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        for(size_t i = 0; i < rows; i++) {
+            const float *row = a + i * lda;
+            float sum = 0;
+            for(size_t k = 0; k < cols; k++) {
+                sum += row[k] * x[k];
+            }
+            y[i] = sum;
+        }
+        return;
+    }
+
+    inline void gemv_t_scalar(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        for(size_t j = 0; j < cols; j++) {
+            y[j] = 0;
+        }
+        for(size_t i = 0; i < rows; i++) {
+            const float *row = a + i * lda;
+            float xVal = x[i];
+            for(size_t j = 0; j < cols; j++) {
+                y[j] += row[j] * xVal;
+            }
+        }
+        return;
+    }
+
+
+#ifdef GEMM_X86
+    /* AVX2 kernels, 6 x 16 register tile (12 accumulators) */
+
+    __attribute__((target("avx2,fma")))
+    inline float hsum_avx2(__m256 v) {
+        __m128 lo = _mm256_castps256_ps128(v);
+        __m128 hi = _mm256_extractf128_ps(v, 1);
+        lo = _mm_add_ps(lo, hi);
+        lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+        lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+        return _mm_cvtss_f32(lo);
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void micro_avx2(size_t kc, const float *a, const float *b, float *c, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+        __m256 acc[6][2];
+        for(size_t i = 0; i < 6; i++) {
+            acc[i][0] = _mm256_setzero_ps();
+            acc[i][1] = _mm256_setzero_ps();
+        }
+
+        for(size_t k = 0; k < kc; k++) {
+            __m256 b0 = _mm256_loadu_ps(b + k * 16);
+            __m256 b1 = _mm256_loadu_ps(b + k * 16 + 8);
+            for(size_t i = 0; i < 6; i++) {
+                __m256 aVal = _mm256_broadcast_ss(a + k * 6 + i);
+                acc[i][0] = _mm256_fmadd_ps(aVal, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_ps(aVal, b1, acc[i][1]);
+            }
+        }
+
+        if(mr == 6 && nr == 16) {
+            for(size_t i = 0; i < 6; i++) {
+                float *row = c + i * ldc;
+                if(accumulate) {
+                    acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(row));
+                    acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(row + 8));
+                }
+                _mm256_storeu_ps(row, acc[i][0]);
+                _mm256_storeu_ps(row + 8, acc[i][1]);
+            }
+        } else {
+            float tile[6 * 16];
+            for(size_t i = 0; i < 6; i++) {
+                _mm256_storeu_ps(tile + i * 16, acc[i][0]);
+                _mm256_storeu_ps(tile + i * 16 + 8, acc[i][1]);
+            }
+            store_tile(tile, 16, c, ldc, mr, nr, accumulate);
+        }
+        return;
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void gemv_n_avx2(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        size_t i = 0;
+        //4 rows at a time share every load of x
+        for(; i + 4 <= rows; i += 4) {
+            const float *r0 = a + i * lda;
+            const float *r1 = r0 + lda;
+            const float *r2 = r1 + lda;
+            const float *r3 = r2 + lda;
+            __m256 s0 = _mm256_setzero_ps();
+            __m256 s1 = _mm256_setzero_ps();
+            __m256 s2 = _mm256_setzero_ps();
+            __m256 s3 = _mm256_setzero_ps();
+
+            size_t k = 0;
+            for(; k + 8 <= cols; k += 8) {
+                __m256 xv = _mm256_loadu_ps(x + k);
+                s0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + k), xv, s0);
+                s1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + k), xv, s1);
+                s2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + k), xv, s2);
+                s3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + k), xv, s3);
+            }
+            float t0 = hsum_avx2(s0), t1 = hsum_avx2(s1), t2 = hsum_avx2(s2), t3 = hsum_avx2(s3);
+            for(; k < cols; k++) {
+                t0 += r0[k] * x[k];
+                t1 += r1[k] * x[k];
+                t2 += r2[k] * x[k];
+                t3 += r3[k] * x[k];
+            }
+            y[i] = t0;
+            y[i + 1] = t1;
+            y[i + 2] = t2;
+            y[i + 3] = t3;
+        }
+
+        for(; i < rows; i++) {
+            const float *row = a + i * lda;
+            __m256 s = _mm256_setzero_ps();
+            size_t k = 0;
+            for(; k + 8 <= cols; k += 8) {
+                s = _mm256_fmadd_ps(_mm256_loadu_ps(row + k), _mm256_loadu_ps(x + k), s);
+            }
+            float t = hsum_avx2(s);
+            for(; k < cols; k++) {
+                t += row[k] * x[k];
+            }
+            y[i] = t;
+        }
+        return;
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline void gemv_t_avx2(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        size_t j = 0;
+        //32 outputs stay in registers while every row streams past
+        for(; j + 32 <= cols; j += 32) {
+            __m256 s0 = _mm256_setzero_ps();
+            __m256 s1 = _mm256_setzero_ps();
+            __m256 s2 = _mm256_setzero_ps();
+            __m256 s3 = _mm256_setzero_ps();
+            for(size_t i = 0; i < rows; i++) {
+                const float *row = a + i * lda + j;
+                __m256 xv = _mm256_broadcast_ss(x + i);
+                s0 = _mm256_fmadd_ps(_mm256_loadu_ps(row), xv, s0);
+                s1 = _mm256_fmadd_ps(_mm256_loadu_ps(row + 8), xv, s1);
+                s2 = _mm256_fmadd_ps(_mm256_loadu_ps(row + 16), xv, s2);
+                s3 = _mm256_fmadd_ps(_mm256_loadu_ps(row + 24), xv, s3);
+            }
+            _mm256_storeu_ps(y + j, s0);
+            _mm256_storeu_ps(y + j + 8, s1);
+            _mm256_storeu_ps(y + j + 16, s2);
+            _mm256_storeu_ps(y + j + 24, s3);
+        }
+
+        for(; j + 8 <= cols; j += 8) {
+            __m256 s = _mm256_setzero_ps();
+            for(size_t i = 0; i < rows; i++) {
+                s = _mm256_fmadd_ps(_mm256_loadu_ps(a + i * lda + j), _mm256_broadcast_ss(x + i), s);
+            }
+            _mm256_storeu_ps(y + j, s);
+        }
+
+        for(; j < cols; j++) {
+            float t = 0;
+            for(size_t i = 0; i < rows; i++) {
+                t += a[i * lda + j] * x[i];
+            }
+            y[j] = t;
+        }
+        return;
+    }
+
+
+    /* AVX-512 kernels, 8 x 32 register tile (16 accumulators) */
+
+    __attribute__((target("avx512f,avx2,fma")))
+    inline float hsum_avx512(__m512 v) {
+        //Spill instead of shuffling, GCC 12 warns on the undefined operand of the 512 bit shuffles
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, v);
+        return hsum_avx2(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+    }
+
+    __attribute__((target("avx512f,avx2,fma")))
+    inline void micro_avx512(size_t kc, const float *a, const float *b, float *c, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+        __m512 acc[8][2];
+        for(size_t i = 0; i < 8; i++) {
+            acc[i][0] = _mm512_setzero_ps();
+            acc[i][1] = _mm512_setzero_ps();
+        }
+
+        for(size_t k = 0; k < kc; k++) {
+            __m512 b0 = _mm512_loadu_ps(b + k * 32);
+            __m512 b1 = _mm512_loadu_ps(b + k * 32 + 16);
+            for(size_t i = 0; i < 8; i++) {
+                __m512 aVal = _mm512_set1_ps(a[k * 8 + i]);
+                acc[i][0] = _mm512_fmadd_ps(aVal, b0, acc[i][0]);
+                acc[i][1] = _mm512_fmadd_ps(aVal, b1, acc[i][1]);
+            }
+        }
+
+        if(mr == 8 && nr == 32) {
+            for(size_t i = 0; i < 8; i++) {
+                float *row = c + i * ldc;
+                if(accumulate) {
+                    acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_loadu_ps(row));
+                    acc[i][1] = _mm512_add_ps(acc[i][1], _mm512_loadu_ps(row + 16));
+                }
+                _mm512_storeu_ps(row, acc[i][0]);
+                _mm512_storeu_ps(row + 16, acc[i][1]);
+            }
+        } else {
+            float tile[8 * 32];
+            for(size_t i = 0; i < 8; i++) {
+                _mm512_storeu_ps(tile + i * 32, acc[i][0]);
+                _mm512_storeu_ps(tile + i * 32 + 16, acc[i][1]);
+            }
+            store_tile(tile, 32, c, ldc, mr, nr, accumulate);
+        }
+        return;
+    }
+
+    __attribute__((target("avx512f,avx2,fma")))
+    inline void gemv_n_avx512(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        size_t i = 0;
+        for(; i + 4 <= rows; i += 4) {
+            const float *r0 = a + i * lda;
+            const float *r1 = r0 + lda;
+            const float *r2 = r1 + lda;
+            const float *r3 = r2 + lda;
+            __m512 s0 = _mm512_setzero_ps();
+            __m512 s1 = _mm512_setzero_ps();
+            __m512 s2 = _mm512_setzero_ps();
+            __m512 s3 = _mm512_setzero_ps();
+
+            size_t k = 0;
+            for(; k + 16 <= cols; k += 16) {
+                __m512 xv = _mm512_loadu_ps(x + k);
+                s0 = _mm512_fmadd_ps(_mm512_loadu_ps(r0 + k), xv, s0);
+                s1 = _mm512_fmadd_ps(_mm512_loadu_ps(r1 + k), xv, s1);
+                s2 = _mm512_fmadd_ps(_mm512_loadu_ps(r2 + k), xv, s2);
+                s3 = _mm512_fmadd_ps(_mm512_loadu_ps(r3 + k), xv, s3);
+            }
+            if(k < cols) {
+                __mmask16 mask = (__mmask16)((1u << (cols - k)) - 1);
+                __m512 xv = _mm512_maskz_loadu_ps(mask, x + k);
+                s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, r0 + k), xv, s0);
+                s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, r1 + k), xv, s1);
+                s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, r2 + k), xv, s2);
+                s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, r3 + k), xv, s3);
+            }
+            y[i] = hsum_avx512(s0);
+            y[i + 1] = hsum_avx512(s1);
+            y[i + 2] = hsum_avx512(s2);
+            y[i + 3] = hsum_avx512(s3);
+        }
+
+        for(; i < rows; i++) {
+            const float *row = a + i * lda;
+            __m512 s = _mm512_setzero_ps();
+            size_t k = 0;
+            for(; k + 16 <= cols; k += 16) {
+                s = _mm512_fmadd_ps(_mm512_loadu_ps(row + k), _mm512_loadu_ps(x + k), s);
+            }
+            if(k < cols) {
+                __mmask16 mask = (__mmask16)((1u << (cols - k)) - 1);
+                s = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, row + k), _mm512_maskz_loadu_ps(mask, x + k), s);
+            }
+            y[i] = hsum_avx512(s);
+        }
+        return;
+    }
+
+    __attribute__((target("avx512f,avx2,fma")))
+    inline void gemv_t_avx512(size_t rows, size_t cols, const float *a, size_t lda, const float *x, float *y) {
+        size_t j = 0;
+        for(; j + 64 <= cols; j += 64) {
+            __m512 s0 = _mm512_setzero_ps();
+            __m512 s1 = _mm512_setzero_ps();
+            __m512 s2 = _mm512_setzero_ps();
+            __m512 s3 = _mm512_setzero_ps();
+            for(size_t i = 0; i < rows; i++) {
+                const float *row = a + i * lda + j;
+                __m512 xv = _mm512_set1_ps(x[i]);
+                s0 = _mm512_fmadd_ps(_mm512_loadu_ps(row), xv, s0);
+                s1 = _mm512_fmadd_ps(_mm512_loadu_ps(row + 16), xv, s1);
+                s2 = _mm512_fmadd_ps(_mm512_loadu_ps(row + 32), xv, s2);
+                s3 = _mm512_fmadd_ps(_mm512_loadu_ps(row + 48), xv, s3);
+            }
+            _mm512_storeu_ps(y + j, s0);
+            _mm512_storeu_ps(y + j + 16, s1);
+            _mm512_storeu_ps(y + j + 32, s2);
+            _mm512_storeu_ps(y + j + 48, s3);
+        }
+
+        for(; j < cols; j += 16) {
+            size_t n = std::min((size_t)16, cols - j);
+            __mmask16 mask = (__mmask16)((n == 16) ? 0xFFFF : ((1u << n) - 1));
+            __m512 s = _mm512_setzero_ps();
+            for(size_t i = 0; i < rows; i++) {
+                s = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i * lda + j), _mm512_set1_ps(x[i]), s);
+            }
+            _mm512_mask_storeu_ps(y + j, mask, s);
+        }
+        return;
+    }
+#endif
+
+
+    /**
+     * @brief Kernel table entry for an instruction set. Falls back to scalar on non x86 builds
+     *
+     * @param isa :: Instruction set
+     *
+     * @return const Kernel& :: Kernels for that instruction set
+     */
+    inline const Kernel &kernel_for(ISA isa) {
+        static const Kernel scalar = {SCALAR, 4, 4, micro_scalar, gemv_n_scalar, gemv_t_scalar};
+#ifdef GEMM_X86
+        static const Kernel avx2 = {AVX2, 6, 16, micro_avx2, gemv_n_avx2, gemv_t_avx2};
+        static const Kernel avx512 = {AVX512, 8, 32, micro_avx512, gemv_n_avx512, gemv_t_avx512};
+        switch(isa) {
+            case AVX512: {
+                return avx512;
+            }
+            case AVX2: {
+                return avx2;
+            }
+            case SCALAR: {
+                break;
+            }
+        }
+#endif
+        (void)isa;
+        return scalar;
+    }
+
+
+    /**
+     * @brief Best instruction set supported by the CPU (and OS) running the program
+     *
+     * @return ISA :: Detected instruction set
+     */
+    inline ISA detected_isa(void) {
+        static const ISA isa = [](void) {
+#ifdef GEMM_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")) {
+                return AVX512;
+            }
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return AVX2;
+            }
+#endif
+            return SCALAR;
+        }();
+        return isa;
+    }
+
+    inline ISA &active_isa_ref(void) {
+        static ISA isa = detected_isa();
+        return isa;
+    }
+
+
+    /**
+     * @brief Instruction set the kernels currently dispatch to
+     *
+     * @return ISA :: Active instruction set
+     */
+    inline ISA active_isa(void) {
+        return active_isa_ref();
+    }
+
+
+    /**
+     * @brief Force the kernels onto an instruction set (testing and benchmarking). Clamped to what the CPU supports
+     *
+     * NOTE: Not thread safe, call before any multiplication starts
+     *
+     * @param isa :: Requested instruction set
+     *
+     * @return ISA :: Instruction set that is now active
+     */
+    inline ISA set_isa(ISA isa) {
+        active_isa_ref() = std::min(isa, detected_isa());
+        return active_isa_ref();
+    }
+
+
+    /**
+     * @brief Plain loops for small products, where packing would cost more than it saves
+     *
+     * @return void :: None
+     */
+    inline void multiply_small(bool transA, bool transB, size_t M, size_t N, size_t K, float alpha,
+                               const float *A, size_t lda, const float *B, size_t ldb, float *C, size_t ldc, bool accumulate) {
+
+        size_t aRow = transA ? 1 : lda; //Stride of op(A) between rows
+        size_t aCol = transA ? lda : 1; //Stride of op(A) between cols
+
+        if(!transB) {
+            //i-k-j keeps the inner loop contiguous in both C and B
+            for(size_t i = 0; i < M; i++) {
+                float *cRow = C + i * ldc;
+                if(!accumulate) {
+                    for(size_t j = 0; j < N; j++) {
+                        cRow[j] = 0;
+                    }
+                }
+                for(size_t k = 0; k < K; k++) {
+                    float aVal = alpha * A[i * aRow + k * aCol];
+                    const float *bRow = B + k * ldb;
+                    for(size_t j = 0; j < N; j++) {
+                        cRow[j] += aVal * bRow[j];
+                    }
+                }
+            }
+        } else {
+            //Rows of B are cols of op(B), so each element is a dot product
+            for(size_t i = 0; i < M; i++) {
+                for(size_t j = 0; j < N; j++) {
+                    const float *bRow = B + j * ldb;
+                    float sum = 0;
+                    for(size_t k = 0; k < K; k++) {
+                        sum += A[i * aRow + k * aCol] * bRow[k];
+                    }
+                    C[i * ldc + j] = accumulate ? C[i * ldc + j] + alpha * sum : alpha * sum;
+                }
+            }
+        }
+        return;
+    }
+
+
+    /**
+     * @brief Pack an mc x kc block of alpha * op(A) into row panels of mr (zero padded), k major within a panel
+     *
+     * @return void :: None
+     */
+    inline void pack_a(bool transA, float alpha, const float *A, size_t lda, size_t i0, size_t k0, size_t mc, size_t kc, size_t mr, float *out) {
+        for(size_t ir = 0; ir < mc; ir += mr) {
+            size_t rows = std::min(mr, mc - ir);
+            float *panel = out + ir * kc;
+
+            if(transA) {
+                //op(A)(i, k) = A(k, i), rows of the panel are contiguous in A
+                for(size_t k = 0; k < kc; k++) {
+                    const float *src = A + (k0 + k) * lda + i0 + ir;
+                    for(size_t r = 0; r < rows; r++) {
+                        panel[k * mr + r] = alpha * src[r];
+                    }
+                    for(size_t r = rows; r < mr; r++) {
+                        panel[k * mr + r] = 0;
+                    }
+                }
+            } else {
+                for(size_t r = 0; r < rows; r++) {
+                    const float *src = A + (i0 + ir + r) * lda + k0;
+                    for(size_t k = 0; k < kc; k++) {
+                        panel[k * mr + r] = alpha * src[k];
+                    }
+                }
+                for(size_t r = rows; r < mr; r++) {
+                    for(size_t k = 0; k < kc; k++) {
+                        panel[k * mr + r] = 0;
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+
+    /**
+     * @brief Pack a kc x nc block of op(B) into col panels of nr (zero padded), k major within a panel
+     *
+     * @return void :: None
+     */
+    inline void pack_b(bool transB, const float *B, size_t ldb, size_t k0, size_t j0, size_t kc, size_t nc, size_t nr, float *out) {
+        for(size_t jr = 0; jr < nc; jr += nr) {
+            size_t cols = std::min(nr, nc - jr);
+            float *panel = out + jr * kc;
+
+            if(transB) {
+                //op(B)(k, j) = B(j, k)
+                for(size_t c = 0; c < cols; c++) {
+                    const float *src = B + (j0 + jr + c) * ldb + k0;
+                    for(size_t k = 0; k < kc; k++) {
+                        panel[k * nr + c] = src[k];
+                    }
+                }
+                for(size_t c = cols; c < nr; c++) {
+                    for(size_t k = 0; k < kc; k++) {
+                        panel[k * nr + c] = 0;
+                    }
+                }
+            } else {
+                for(size_t k = 0; k < kc; k++) {
+                    const float *src = B + (k0 + k) * ldb + j0 + jr;
+                    for(size_t c = 0; c < cols; c++) {
+                        panel[k * nr + c] = src[c];
+                    }
+                    for(size_t c = cols; c < nr; c++) {
+                        panel[k * nr + c] = 0;
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+
+    /**
+     * @brief Cache blocked product using packed panels and a register tiled micro kernel
+     *
+     * @return void :: None
+     */
+    inline void multiply_blocked(const Kernel &kernel, bool transA, bool transB, size_t M, size_t N, size_t K, float alpha,
+                                 const float *A, size_t lda, const float *B, size_t ldb, float *C, size_t ldc,
+                                 bool accumulate, const Epilogue *epilogue) {
+
+        //Packing buffers persist per thread, so steady state multiplication never allocates
+        thread_local std::vector<float> packedA;
+        thread_local std::vector<float> packedB;
+
+        size_t mr = kernel.mr;
+        size_t nr = kernel.nr;
+        size_t mcMax = (MC + mr - 1) / mr * mr;
+        size_t ncMax = (NC + nr - 1) / nr * nr;
+        if(packedA.size() < mcMax * KC) {
+            packedA.resize(mcMax * KC);
+        }
+        if(packedB.size() < ncMax * KC) {
+            packedB.resize(ncMax * KC);
+        }
+
+        for(size_t jc = 0; jc < N; jc += NC) {
+            size_t nc = std::min(NC, N - jc);
+
+            for(size_t pc = 0; pc < K; pc += KC) {
+                size_t kc = std::min(KC, K - pc);
+                bool lastPanel = pc + kc == K;
+                pack_b(transB, B, ldb, pc, jc, kc, nc, nr, packedB.data());
+
+                for(size_t ic = 0; ic < M; ic += MC) {
+                    size_t mc = std::min(MC, M - ic);
+                    pack_a(transA, alpha, A, lda, ic, pc, mc, kc, mr, packedA.data());
+
+                    for(size_t jr = 0; jr < nc; jr += nr) {
+                        for(size_t ir = 0; ir < mc; ir += mr) {
+                            float *tile = C + (ic + ir) * ldc + jc + jr;
+                            size_t rows = std::min(mr, mc - ir);
+                            size_t cols = std::min(nr, nc - jr);
+                            kernel.micro(kc, packedA.data() + ir * kc, packedB.data() + jr * kc, tile, ldc,
+                                         rows, cols, pc > 0 || accumulate);
+
+                            //Tile is complete and still in L1
+                            if(lastPanel && epilogue) {
+                                const float *rowData = epilogue->rowData ? epilogue->rowData + ic + ir : NULL;
+                                const float *cellData = epilogue->cellData ? epilogue->cellData + (tile - C) : NULL;
+                                epilogue->apply(tile, ldc, rows, cols, rowData, cellData);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+
+    /**
+     * @brief Run an epilogue over all of C (paths that finish C in one go)
+     *
+     * @return void :: None
+     */
+    inline void finish(const Epilogue *epilogue, float *C, size_t ldc, size_t M, size_t N) {
+        if(epilogue) {
+            epilogue->apply(C, ldc, M, N, epilogue->rowData, epilogue->cellData);
+        }
+        return;
+    }
+
+
+    /**
+     * @brief C = alpha * op(A) * op(B) (+ C). C is M x N, op(A) is M x K, op(B) is K x N
+     *
+     * @param transA :: Use A^T (A is stored K x M)
+     * @param transB :: Use B^T (B is stored N x K)
+     * @param M :: Rows of C
+     * @param N :: Cols of C
+     * @param K :: Inner dimension
+     * @param A :: A matrix with leading dimension lda
+     * @param B :: B matrix with leading dimension ldb
+     * @param C :: Output matrix with leading dimension ldc. Must not alias A or B
+     * @param alpha :: Scale of the product
+     * @param accumulate :: Add the product to C instead of overwriting it
+     * @param epilogue :: Optional pass run on C once the product is complete (NULL for none)
+     *
+     * @return void :: None
+     */
+    inline void multiply(bool transA, bool transB, size_t M, size_t N, size_t K,
+                         const float *A, size_t lda, const float *B, size_t ldb, float *C, size_t ldc,
+                         float alpha = 1.0f, bool accumulate = false, const Epilogue *epilogue = NULL) {
+
+        if(M == 0 || N == 0) {
+            return;
+        }
+        if(K == 0) {
+            if(!accumulate) {
+                for(size_t i = 0; i < M; i++) {
+                    std::fill(C + i * ldc, C + i * ldc + N, 0.0f);
+                }
+            }
+            finish(epilogue, C, ldc, M, N);
+            return;
+        }
+
+        const Kernel &kernel = kernel_for(active_isa());
+
+        //Matrix-vector shapes (batch size 1)
+        if(N == 1 && !transB && ldb == 1 && ldc == 1) {
+            //Scaled or accumulated results go through a scratch vector first
+            thread_local std::vector<float> scratch;
+            bool direct = alpha == 1.0f && !accumulate;
+            if(!direct && scratch.size() < M) {
+                scratch.resize(M);
+            }
+            float *y = direct ? C : scratch.data();
+
+            if(transA) {
+                kernel.gemvT(K, M, A, lda, B, y); //W^T * dZ
+            } else {
+                kernel.gemvN(M, K, A, lda, B, y); //W * x
+            }
+
+            if(!direct) {
+                for(size_t i = 0; i < M; i++) {
+                    C[i] = accumulate ? C[i] + alpha * y[i] : alpha * y[i];
+                }
+            }
+            finish(epilogue, C, ldc, M, N);
+            return;
+        }
+        if(K == 1 && !transA && transB) {
+            //Outer product dZ * aPrev^T. Accumulating makes this a rank one update in a single pass over C
+            for(size_t i = 0; i < M; i++) {
+                float aVal = alpha * A[i * lda];
+                float *cRow = C + i * ldc;
+                if(accumulate) {
+                    for(size_t j = 0; j < N; j++) {
+                        cRow[j] += aVal * B[j * ldb];
+                    }
+                } else {
+                    for(size_t j = 0; j < N; j++) {
+                        cRow[j] = aVal * B[j * ldb];
+                    }
+                }
+            }
+            finish(epilogue, C, ldc, M, N);
+            return;
+        }
+
+        if(M * N * K <= SMALL_PRODUCT) {
+            multiply_small(transA, transB, M, N, K, alpha, A, lda, B, ldb, C, ldc, accumulate);
+            finish(epilogue, C, ldc, M, N);
+            return;
+        }
+
+        multiply_blocked(kernel, transA, transB, M, N, K, alpha, A, lda, B, ldb, C, ldc, accumulate, epilogue);
+        return;
+    }
+}
+
+
+
+#endif
@@ -0,0 +1,593 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+#include <memory>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "./perceptron.h++"
+
+
+/**
+ * NOTE: Reentrant inference
+ * InferenceModel holds read only weights (a private copy of a Perceptron, or a mapped model file)
+ * Workspace holds the activations of one caller. Any number of threads can run the same model at once
+ * as long as each passes its own workspace, so serving threads share one copy of the weights
+ *
+ * InferenceServer sits on top and merges concurrent single sample requests into micro-batches
+ */
+
+
+namespace perceptron {
+
+    class InferenceModel;
+
+    class Workspace {
+        private:
+        //Layer outputs ping-pong between the two buffers, each holds widest layer x batch values
+        std::vector<float> buffers[2];
+
+        friend class InferenceModel;
+
+        public:
+        Workspace(void) {}
+
+        /**
+         * @brief Allocate a workspace for a model up front
+         *
+         * @param model :: Model the workspace will be used with
+         * @param maxBatch :: Largest batch expected (larger batches still work, they grow the buffers)
+         */
+        Workspace(const InferenceModel &model, size_t maxBatch = 1);
+
+        /**
+         * @brief Make sure the buffers fit a batch. Never shrinks, so a warm workspace does not allocate
+         *
+         * @param model :: Model the workspace is used with
+         * @param batchSize :: Samples per forward pass
+         *
+         * @return void :: None
+         */
+        void reserve(const InferenceModel &model, size_t batchSize);
+
+        /**
+         * @brief Memory held by the workspace
+         *
+         * @return size_t :: Bytes of activation buffers
+         */
+        size_t bytes(void) const {
+            return (this->buffers[0].capacity() + this->buffers[1].capacity()) * sizeof(float);
+        }
+    };
+
+
+    class InferenceModel {
+        private:
+        //Exactly one of these owns the memory the views point into. Copies of the model share it
+        std::shared_ptr<const std::vector<float>> weights;
+        std::shared_ptr<const modelfile::MappedModel> mapping;
+        std::vector<modelfile::LayerView> layers;
+        size_t widest;
+
+
+        /**
+         * @brief Check the layers can be run (known activations) and record the widest layer
+         *
+         * @return bool :: true if the model is usable
+         */
+        bool validate(void) {
+            this->widest = 0;
+            for(const modelfile::LayerView &view : this->layers) {
+                if(view.act > TANH) {
+                    return false;
+                }
+                this->widest = std::max(this->widest, view.rows);
+            }
+            return !this->layers.empty();
+        }
+
+        public:
+        InferenceModel(void) {
+            this->widest = 0;
+        }
+
+        /**
+         * @brief Snapshot the weights of a network
+         *
+         * The copy is taken once, later training or read_file calls on net do not affect the model
+         *
+         * @param net :: Network to copy
+         */
+        InferenceModel(Perceptron &net) {
+            //One contiguous block, each matrix starting on a 64 byte boundary
+            const size_t align = modelfile::ALIGNMENT / sizeof(float);
+            std::vector<size_t> offsets;
+            size_t total = 0;
+            for(Layer &layer : net.layers) {
+                offsets.push_back(total);
+                total += (layer.w.get_vector().size() + align - 1) / align * align;
+                offsets.push_back(total);
+                total += (layer.b.get_vector().size() + align - 1) / align * align;
+            }
+
+            std::shared_ptr<std::vector<float>> block = std::make_shared<std::vector<float>>(total, 0.0f);
+            for(size_t i = 0; i < net.layers.size(); i++) {
+                Layer &layer = net.layers[i];
+                std::copy(layer.w.get_vector().begin(), layer.w.get_vector().end(), block->begin() + offsets[2 * i]);
+                std::copy(layer.b.get_vector().begin(), layer.b.get_vector().end(), block->begin() + offsets[2 * i + 1]);
+
+                modelfile::LayerView view;
+                view.rows = layer.w.get_rows();
+                view.cols = layer.w.get_cols();
+                view.act = layer.act;
+                view.w = block->data() + offsets[2 * i];
+                view.b = block->data() + offsets[2 * i + 1];
+                this->layers.push_back(view);
+            }
+            this->weights = block;
+            this->validate();
+        }
+
+
+        /**
+         * @brief Map a model written by Perceptron::save_file. Weights are used in place, not copied
+         *
+         * @param fileName :: Binary model file
+         *
+         * @return bool :: Indication of if the model was mapped (the model is left empty on failure)
+         */
+        bool open(const std::string &fileName) {
+            this->weights.reset();
+            this->mapping.reset();
+            this->layers.clear();
+            this->widest = 0;
+
+            std::shared_ptr<modelfile::MappedModel> model = std::make_shared<modelfile::MappedModel>();
+            if(!model->open(fileName)) {
+                return false;
+            }
+
+            this->layers = model->get_layers();
+            if(!this->validate()) {
+                this->layers.clear();
+                return false;
+            }
+            this->mapping = model;
+            return true;
+        }
+
+
+        /**
+         * @brief Whether the model holds any layers
+         *
+         * @return bool :: true if nothing is loaded
+         */
+        bool empty(void) const {
+            return this->layers.empty();
+        }
+
+        size_t input_size(void) const {
+            return this->layers.empty() ? 0 : this->layers.front().cols;
+        }
+
+        size_t output_size(void) const {
+            return this->layers.empty() ? 0 : this->layers.back().rows;
+        }
+
+        /**
+         * @brief Largest layer output, sets the workspace size per sample
+         *
+         * @return size_t :: Neurons in the widest layer
+         */
+        size_t widest_layer(void) const {
+            return this->widest;
+        }
+
+        /**
+         * @brief Memory used by the weights and biases (shared by every copy of the model)
+         *
+         * @return size_t :: Bytes of parameters
+         */
+        size_t weight_bytes(void) const {
+            size_t params = 0;
+            for(const modelfile::LayerView &view : this->layers) {
+                params += view.rows * view.cols + view.rows;
+            }
+            return params * sizeof(float);
+        }
+
+
+        /**
+         * @brief Forward pass on a batch. Safe to call from many threads at once with different workspaces
+         *
+         * @param x :: Inputs, one sample per column (inputs x batch size, row major)
+         * @param batchSize :: Number of samples
+         * @param ws :: Caller's workspace, grown if it is too small
+         *
+         * @return const float* :: Outputs inside ws (outputs x batch size, row major), valid until ws is used again
+         */
+        const float *forward(const float *x, size_t batchSize, Workspace &ws) const {
+            if(this->layers.empty()) {
+                throw std::logic_error("No model loaded\n");
+            }
+            ws.reserve(*this, batchSize);
+
+            const float *in = x;
+            for(size_t i = 0; i < this->layers.size(); i++) {
+                const modelfile::LayerView &view = this->layers[i];
+                float *out = ws.buffers[i % 2].data();
+
+                gemm::Epilogue epilogue = {epilogue_for((ACTIVATION_FUNCTION)view.act), view.b, NULL};
+                gemm::multiply(false, false, view.rows, batchSize, view.cols, view.w, view.cols, in, batchSize, out, batchSize,
+                               1.0f, false, &epilogue);
+                in = out;
+            }
+            return in;
+        }
+
+        /**
+         * @brief Forward pass on a single sample
+         *
+         * @param x :: Input vector
+         * @param ws :: Caller's workspace
+         *
+         * @return const float* :: output_size() values inside ws, valid until ws is used again
+         */
+        const float *forward(const std::vector<float> &x, Workspace &ws) const {
+            if(x.size() != this->input_size()) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+            return this->forward(x.data(), 1, ws);
+        }
+
+        /**
+         * @brief Run forward pass and return predicted class index
+         *
+         * @param x :: Input vector
+         * @param ws :: Caller's workspace
+         *
+         * @return int :: Index of highest output value
+         */
+        int predict_class(const std::vector<float> &x, Workspace &ws) const {
+            const float *out = this->forward(x, ws);
+            int best = 0;
+            for(size_t i = 1; i < this->output_size(); i++) {
+                if(out[i] > out[best]) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+    };
+
+
+    inline Workspace::Workspace(const InferenceModel &model, size_t maxBatch) {
+        this->reserve(model, maxBatch);
+    }
+
+    inline void Workspace::reserve(const InferenceModel &model, size_t batchSize) {
+        size_t needed = model.widest_layer() * batchSize;
+        if(this->buffers[0].size() < needed) {
+            this->buffers[0].resize(needed);
+            this->buffers[1].resize(needed);
+        }
+        return;
+    }
+
+
+    /**
+     * @brief Inference only network running straight from a mapped binary model file
+     *
+     * Weights are never copied, so processes mapping the same file share one copy in the page cache
+     * Only activations are allocated. Not thread safe (owns a single workspace), use InferenceModel
+     * with a workspace per thread to share a mapped model between threads
+     */
+    class MappedPerceptron {
+        private:
+        InferenceModel model;
+        Workspace workspace;
+        std::vector<float> output;
+
+        public:
+        /**
+         * @brief Map a model written by Perceptron::save_file
+         *
+         * @param fileName :: Binary model file
+         *
+         * @return bool :: Indication of if the model was mapped
+         */
+        bool open(std::string fileName) {
+            if(!this->model.open(fileName)) {
+                return false;
+            }
+            this->workspace.reserve(this->model, 1);
+            this->output.resize(this->model.output_size());
+            return true;
+        }
+
+        /**
+         * @brief Forward pass on a single sample
+         *
+         * @param x :: Input vector
+         *
+         * @return std::vector<float>& :: Reference to internal network output
+         */
+        const std::vector<float> &forward(const std::vector<float> &x) {
+            const float *out = this->model.forward(x, this->workspace);
+            std::copy(out, out + this->output.size(), this->output.begin());
+            return this->output;
+        }
+
+        /**
+         * @brief Run forward pass and return predicted class index
+         *
+         * @param x :: Input vector
+         * @return int :: Index of highest output value
+         */
+        int predict_class(const std::vector<float> &x) {
+            return this->model.predict_class(x, this->workspace);
+        }
+
+        /**
+         * @brief The mapped model, to share with other threads
+         *
+         * @return const InferenceModel& :: Model
+         */
+        const InferenceModel &get_model(void) const {
+            return this->model;
+        }
+    };
+
+
+    /**
+     * @brief Batching front end for concurrent single sample requests
+     *
+     * Callers block in predict/predict_class while worker threads collect queued requests into a batch.
+     * A batch runs as soon as it holds maxBatch requests, or once its oldest request has waited maxWait.
+     * One batched forward pass is much cheaper per sample than many single sample passes (the weights
+     * are streamed once per batch instead of once per sample), which keeps tail latency down under load
+     */
+    class InferenceServer {
+        private:
+        typedef struct Request {
+            const float *x;
+            float *out; //NULL when only the class is wanted
+            int label;
+            bool done;
+            std::exception_ptr error;
+            std::chrono::steady_clock::time_point arrival;
+            std::condition_variable ready;
+        } Request;
+
+        InferenceModel model;
+        size_t maxBatch;
+        std::chrono::microseconds maxWait;
+
+        std::mutex lock;
+        std::condition_variable arrived; //Signalled when a request is queued
+        std::deque<Request *> queue;
+        bool stopping;
+
+        size_t batches; //Batches run so far
+        size_t served; //Requests answered so far
+
+        std::vector<std::thread> workers;
+
+
+        /**
+         * @brief Loop run by every worker: wait for requests, batch them, answer them
+         *
+         * @return void :: None
+         */
+        void worker_loop(void) {
+            size_t nIn = this->model.input_size();
+            size_t nOut = this->model.output_size();
+            Workspace ws(this->model, this->maxBatch);
+            std::vector<float> x(nIn * this->maxBatch);
+            std::vector<Request *> taken;
+            taken.reserve(this->maxBatch);
+
+            while(1) {
+                {
+                    std::unique_lock<std::mutex> guard(this->lock);
+                    this->arrived.wait(guard, [&](void) {
+                        return this->stopping || !this->queue.empty();
+                    });
+                    if(this->queue.empty()) {
+                        return; //Stopping, and every request has been answered
+                    }
+
+                    //Give the batch time to fill, but never hold the oldest request past maxWait
+                    //Other workers can take requests meanwhile, so the front and its deadline are read again after every wakeup
+                    while(!this->queue.empty() && !this->stopping && this->queue.size() < this->maxBatch) {
+                        std::chrono::steady_clock::time_point deadline = this->queue.front()->arrival + this->maxWait;
+                        if(std::chrono::steady_clock::now() >= deadline) {
+                            break;
+                        }
+                        this->arrived.wait_until(guard, deadline);
+                    }
+                    if(this->queue.empty()) {
+                        continue; //Another worker served them
+                    }
+
+                    size_t n = std::min(this->queue.size(), this->maxBatch);
+                    taken.assign(this->queue.begin(), this->queue.begin() + n);
+                    this->queue.erase(this->queue.begin(), this->queue.begin() + n);
+                }
+
+                //Samples become the columns of one input matrix
+                size_t n = taken.size();
+                for(size_t j = 0; j < n; j++) {
+                    for(size_t i = 0; i < nIn; i++) {
+                        x[i * n + j] = taken[j]->x[i];
+                    }
+                }
+
+                const float *out = NULL;
+                std::exception_ptr error = nullptr;
+                try {
+                    out = this->model.forward(x.data(), n, ws);
+                } catch(...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> guard(this->lock);
+                for(size_t j = 0; j < n; j++) {
+                    Request *request = taken[j];
+                    if(error) {
+                        request->error = error;
+                    } else {
+                        int best = 0;
+                        for(size_t i = 0; i < nOut; i++) {
+                            float val = out[i * n + j];
+                            if(request->out) {
+                                request->out[i] = val;
+                            }
+                            if(val > out[best * n + j]) {
+                                best = i;
+                            }
+                        }
+                        request->label = best;
+                    }
+                    request->done = true;
+                    request->ready.notify_one(); //Lock is held, so the caller cannot return (and destroy request) first
+                }
+                this->batches++;
+                this->served += n;
+            }
+        }
+
+
+        /**
+         * @brief Queue a request and wait for a worker to answer it
+         *
+         * @param request :: Request filled in by the caller (x and out)
+         *
+         * @return void :: None
+         */
+        void submit(Request &request) {
+            request.label = 0;
+            request.done = false;
+            request.error = nullptr;
+            request.arrival = std::chrono::steady_clock::now();
+
+            std::unique_lock<std::mutex> guard(this->lock);
+            if(this->stopping) {
+                throw std::logic_error("Inference server is stopping\n");
+            }
+            this->queue.push_back(&request);
+            this->arrived.notify_one();
+            request.ready.wait(guard, [&](void) {
+                return request.done;
+            });
+
+            if(request.error) {
+                std::rethrow_exception(request.error);
+            }
+            return;
+        }
+
+        public:
+        /**
+         * @brief Start a server on a model. The server keeps its own (shared) reference to the weights
+         *
+         * @param model :: Model to serve
+         * @param maxBatch :: Most requests run in one forward pass
+         * @param maxWait :: Longest a request waits for its batch to fill
+         * @param threads :: Worker threads running batches
+         */
+        InferenceServer(const InferenceModel &model, size_t maxBatch = 32,
+                        std::chrono::microseconds maxWait = std::chrono::microseconds(200), size_t threads = 1) : model(model) {
+            if(model.empty()) {
+                throw std::invalid_argument("Inference server needs a loaded model\n");
+            }
+            if(maxBatch == 0 || threads == 0) {
+                throw std::invalid_argument("Batch size and thread count must be at least 1\n");
+            }
+
+            this->maxBatch = maxBatch;
+            this->maxWait = maxWait;
+            this->stopping = false;
+            this->batches = 0;
+            this->served = 0;
+
+            for(size_t i = 0; i < threads; i++) {
+                this->workers.emplace_back(&InferenceServer::worker_loop, this);
+            }
+        }
+
+        InferenceServer(const InferenceServer &) = delete;
+        InferenceServer &operator=(const InferenceServer &) = delete;
+
+        /**
+         * @brief Answer every queued request then stop the workers
+         */
+        ~InferenceServer() {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->arrived.notify_all();
+            for(std::thread &worker : this->workers) {
+                worker.join();
+            }
+        }
+
+
+        /**
+         * @brief Forward pass on a single sample, batched with other concurrent callers. Thread safe
+         *
+         * @param x :: Input vector
+         * @param out :: Output vector, resized to the output size
+         *
+         * @return void :: None
+         */
+        void predict(const std::vector<float> &x, std::vector<float> &out) {
+            if(x.size() != this->model.input_size()) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+            out.resize(this->model.output_size());
+
+            Request request;
+            request.x = x.data();
+            request.out = out.data();
+            this->submit(request);
+            return;
+        }
+
+        /**
+         * @brief Predicted class of a single sample, batched with other concurrent callers. Thread safe
+         *
+         * @param x :: Input vector
+         *
+         * @return int :: Index of highest output value
+         */
+        int predict_class(const std::vector<float> &x) {
+            if(x.size() != this->model.input_size()) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+
+            Request request;
+            request.x = x.data();
+            request.out = NULL;
+            this->submit(request);
+            return request.label;
+        }
+
+        /**
+         * @brief Average requests per batch so far, shows how well requests are being combined
+         *
+         * @return float :: Mean batch size (0 before the first batch)
+         */
+        float mean_batch_size(void) {
+            std::lock_guard<std::mutex> guard(this->lock);
+            return this->batches == 0 ? 0.0f : (float)this->served / (float)this->batches;
+        }
+    };
+}
+
+
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**
+ * NOTE: Read only memory mapping of a whole file (Linux/WSL)
+ * Pages are loaded lazily by the kernel and shared between processes mapping the same file
+ */
+
+
+namespace mapped {
+    class MappedFile {
+        private:
+        const uint8_t *bytes;
+        size_t length;
+
+        public:
+        MappedFile(void) {
+            this->bytes = NULL;
+            this->length = 0;
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+            this->close();
+        }
+
+
+        /**
+         * @brief Map a file into memory (read only). Closes any file already mapped
+         *
+         * @param fileName :: File to map
+         *
+         * @return bool :: Indication of if the file was mapped (true = yes)
+         */
+        bool open(const std::string &fileName) {
+            this->close();
+
+            int fd = ::open(fileName.c_str(), O_RDONLY);
+            if(fd < 0) {
+                return false;
+            }
+
+            struct stat info;
+            if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+
+            void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd); //Mapping stays valid after the descriptor is closed
+            if(map == MAP_FAILED) {
+                return false;
+            }
+
+            this->bytes = (const uint8_t *)map;
+            this->length = (size_t)info.st_size;
+            return true;
+        }
+
+
+        /**
+         * @brief Unmap the file (no-op if nothing is mapped)
+         *
+         * @return void :: None
+         */
+        void close(void) {
+            if(this->bytes) {
+                munmap((void *)this->bytes, this->length);
+            }
+            this->bytes = NULL;
+            this->length = 0;
+            return;
+        }
+
+
+        /**
+         * @brief Hint the kernel about how the mapping will be read
+         *
+         * @param sequential :: true for one front to back pass, false for random access
+         *
+         * @return void :: None
+         */
+        void advise(bool sequential) {
+            if(this->bytes) {
+                madvise((void *)this->bytes, this->length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Start of the mapping (page aligned)
+         *
+         * @return const uint8_t* :: Mapped bytes, NULL if nothing is mapped
+         */
+        const uint8_t *data(void) const {
+            return this->bytes;
+        }
+
+
+        /**
+         * @brief Size of the mapping
+         *
+         * @return size_t :: Bytes mapped
+         */
+        size_t size(void) const {
+            return this->length;
+        }
+    };
+}
+
+
+
+#endif
@@ -5,12 +5,15 @@
 #include <fstream>
 #include <cmath>
 #include <vector>
+#include <type_traits>
+#include "./gemm.h++"
 
 
 /**
  * NOTE: This is a CPU-based library
  * Its intended for use with small perceptrons
  * std::thread could be used for larger matricies
+ * Float multiplication is handled by the kernels in gemm.h++
  */
 
 
@@ -60,6 +63,19 @@ namespace matrix {
             this->data = data;
         }
 
+        /**
+         * @brief Construct a matrix by copying from a raw array
+         * 
+         * @param rows :: Rows of matrix
+         * @param cols :: Cols of matrix
+         * @param src :: rows * cols elements (row major)
+         */
+        Matrix(size_t rows, size_t cols, const T *src) {
+            this->rows = rows;
+            this->cols = cols;
+            this->data.assign(src, src + rows * cols);
+        }
+
        /**
         * @brief Fill a matrix with a vector (pre-dimensioned)
         * 
@@ -67,7 +83,7 @@ namespace matrix {
         *
         * @return void :: None
         */
-        void fill_vector(std::vector<T> &vec) {
+        void fill_vector(const std::vector<T> &vec) {
             this->data = vec;
             return;
         } 
@@ -83,6 +99,32 @@ namespace matrix {
         } 
 
 
+        /**
+         * @brief Raw pointer to a matrix's data (row major), for kernels and bulk fills
+         *
+         * @return T* :: Pointer to the first element
+         */
+        T *get_data(void) {
+            return this->data.data();
+        }
+
+
+        /**
+         * @brief Change the dimensions of a matrix. The buffer is only reallocated if it grows past its capacity
+         * 
+         * @param rows :: New rows of the matrix
+         * @param cols :: New cols of the matrix
+         * 
+         * @return Matrix<T>& :: This matrix (result)
+         */
+        Matrix<T> &resize(size_t rows, size_t cols) {
+            this->rows = rows;
+            this->cols = cols;
+            this->data.resize(rows * cols);
+            return *this;
+        }
+
+
         /**
          * @brief Refer to a element in a matrix
          * 
@@ -105,6 +147,8 @@ namespace matrix {
          * 
          * @param x :: X matrix
          * @param w :: W matrix
+         * @param transposeX :: Use x^T
+         * @param transposeW :: Use w^T
          * 
          * @return Matrix<T>& :: Result matrix (this)
          */
@@ -114,9 +158,15 @@ namespace matrix {
             size_t xr = transposeX ? x.cols : x.rows;
             size_t xc = transposeX ? x.rows : x.cols;
 
-            size_t wr = transposeW ? w.cols : w.rows;
             size_t wc = transposeW ? w.rows : w.cols;
 
+            //Float uses the blocked/SIMD kernels
+            if constexpr (std::is_same<T, float>::value) {
+                gemm::multiply(transposeX, transposeW, xr, wc, xc,
+                               x.data.data(), x.cols, w.data.data(), w.cols, this->data.data(), this->cols);
+                return *this;
+            }
+
             for(size_t i = 0; i < xr; i++) {
                 for(size_t j = 0; j < wc; j++) {
 
@@ -228,6 +278,25 @@ namespace matrix {
         }
 
 
+        /**
+         * @brief Sum accross all columns of a matrix into this column vector (overwrites)
+         * 
+         * @param matrix :: Columns to sum accross
+         * 
+         * @return Matrix<T>& :: This matrix (result)
+         */
+        Matrix<T> &sum_cols(Matrix<T> &matrix) {
+            for(size_t i = 0; i < this->rows; i++) {
+                T sum = 0;
+                for(size_t j = 0; j < matrix.cols; j++) {
+                    sum += matrix.at(i, j);
+                }
+                this->at(i, 0) = sum;
+            }
+            return *this;
+        }
+
+
         /**
          * @brief Append a matrix to a file, including dimensions
          * 
@@ -0,0 +1,369 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include "./mapped_file.h++"
+
+
+/**
+ * NOTE: Versioned binary model format
+ *
+ * Header (24 bytes)
+ *   magic "MLPB", uint32 version, uint32 layer count, uint32 flags, uint64 file size
+ * Layer table (32 bytes per layer)
+ *   uint32 rows, uint32 cols, uint32 activation, uint32 reserved (0), uint64 weight offset, uint64 bias offset
+ * Data blocks
+ *   Raw float32 weights (rows x cols, row major) then biases (rows), each block starting on a 64 byte boundary
+ *
+ * Flags
+ *   0 :: float32 weights (Perceptron::save_file)
+ *   FLAG_INT8 :: int8 weights (rows x cols), followed by one float32 scale per row in the next 64 byte
+ *                aligned block, then float32 biases. Written by QuantizedModel::save_file
+ *
+ * Everything is little-endian. Offsets are from the start of the file, so a mapped file can be used in place
+ */
+
+
+namespace modelfile {
+
+    const char MAGIC[4] = {'M', 'L', 'P', 'B'};
+    const uint32_t VERSION = 1;
+    const size_t ALIGNMENT = 64;
+    const size_t HEADER_SIZE = 24;
+    const size_t LAYER_ENTRY_SIZE = 32;
+    const uint32_t FLAG_INT8 = 1;
+
+    static_assert(std::numeric_limits<float>::is_iec559, "Model files store IEEE-754 floats");
+
+    //Read only view of one layer. Points into a mapped file or into memory owned elsewhere
+    typedef struct LayerView {
+        size_t rows;
+        size_t cols;
+        uint32_t act;
+        const float *w; //rows x cols, row major
+        const float *b; //rows
+    } LayerView;
+
+    //Read only view of one int8 layer. Weight row i is scale[i] * w[i][...]
+    typedef struct QuantizedLayerView {
+        size_t rows;
+        size_t cols;
+        uint32_t act;
+        const int8_t *w; //rows x cols, row major
+        const float *scale; //rows
+        const float *b; //rows
+    } QuantizedLayerView;
+
+    //A run of bytes written to its own aligned block
+    typedef struct Block {
+        const void *data;
+        size_t bytes;
+    } Block;
+
+    //Layer table entry plus its data blocks in file order (weights first, biases last)
+    typedef struct LayerBlocks {
+        size_t rows;
+        size_t cols;
+        uint32_t act;
+        std::vector<Block> blocks;
+    } LayerBlocks;
+
+
+    /**
+     * @brief Whether this machine stores numbers little-endian (the only layout the format can be mapped with)
+     *
+     * @return bool :: true on little-endian hosts
+     */
+    inline bool host_little_endian(void) {
+        uint32_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    inline size_t align_up(size_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    inline void put_u32(std::vector<uint8_t> &out, size_t offset, uint32_t val) {
+        std::memcpy(out.data() + offset, &val, 4);
+    }
+
+    inline void put_u64(std::vector<uint8_t> &out, size_t offset, uint64_t val) {
+        std::memcpy(out.data() + offset, &val, 8);
+    }
+
+    inline uint32_t get_u32(const uint8_t *in) {
+        uint32_t val;
+        std::memcpy(&val, in, 4);
+        return val;
+    }
+
+    inline uint64_t get_u64(const uint8_t *in) {
+        uint64_t val;
+        std::memcpy(&val, in, 8);
+        return val;
+    }
+
+
+    /**
+     * @brief Check whether a file starts with the binary model magic
+     *
+     * @param fileName :: File to check
+     *
+     * @return bool :: true if the file is a binary model
+     */
+    inline bool is_binary(const std::string &fileName) {
+        std::ifstream file(fileName, std::ios::binary);
+        char magic[4];
+        if(!file.read(magic, 4)) {
+            return false;
+        }
+        return std::memcmp(magic, MAGIC, 4) == 0;
+    }
+
+
+    /**
+     * @brief Write a model file with a single open and one write per block
+     *
+     * @param fileName :: File to (over)write
+     * @param flags :: Header flags describing how the blocks are stored
+     * @param layers :: Layer shapes and their data blocks
+     *
+     * @return bool :: Indication of if the write was successful
+     */
+    inline bool write_blocks(const std::string &fileName, uint32_t flags, const std::vector<LayerBlocks> &layers) {
+        if(!host_little_endian()) {
+            return false;
+        }
+
+        //Counts and dimensions are stored as 32 bit fields
+        if(layers.size() > UINT32_MAX) {
+            return false;
+        }
+        for(const LayerBlocks &layer : layers) {
+            if(layer.rows > UINT32_MAX || layer.cols > UINT32_MAX) {
+                return false;
+            }
+        }
+
+        //Lay out the data blocks
+        size_t tableEnd = HEADER_SIZE + LAYER_ENTRY_SIZE * layers.size();
+        std::vector<std::vector<uint64_t>> offsets(layers.size());
+        size_t offset = align_up(tableEnd);
+        for(size_t i = 0; i < layers.size(); i++) {
+            for(const Block &block : layers[i].blocks) {
+                offsets[i].push_back(offset);
+                offset = align_up(offset + block.bytes);
+            }
+        }
+        size_t fileSize = offset;
+
+        //Header and layer table, zero filled up to the first block
+        std::vector<uint8_t> head(align_up(tableEnd), 0);
+        std::memcpy(head.data(), MAGIC, 4);
+        put_u32(head, 4, VERSION);
+        put_u32(head, 8, (uint32_t)layers.size());
+        put_u32(head, 12, flags);
+        put_u64(head, 16, fileSize);
+        for(size_t i = 0; i < layers.size(); i++) {
+            size_t entry = HEADER_SIZE + LAYER_ENTRY_SIZE * i;
+            put_u32(head, entry, (uint32_t)layers[i].rows);
+            put_u32(head, entry + 4, (uint32_t)layers[i].cols);
+            put_u32(head, entry + 8, layers[i].act);
+            put_u32(head, entry + 12, 0);
+            put_u64(head, entry + 16, offsets[i].front());
+            put_u64(head, entry + 24, offsets[i].back());
+        }
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if(!file) {
+            return false;
+        }
+        file.write((const char *)head.data(), head.size());
+
+        //Every block is padded up to the start of the next one (or the end of the file)
+        const char padding[ALIGNMENT] = {0};
+        for(size_t i = 0; i < layers.size(); i++) {
+            for(size_t j = 0; j < layers[i].blocks.size(); j++) {
+                const Block &block = layers[i].blocks[j];
+                file.write((const char *)block.data, block.bytes);
+                file.write(padding, align_up(offsets[i][j] + block.bytes) - (offsets[i][j] + block.bytes));
+            }
+        }
+
+        return file.good(); //Make sure file is ok
+    }
+
+
+    /**
+     * @brief Write float32 layers to a binary model file
+     *
+     * @param fileName :: File to (over)write
+     * @param layers :: Layers to write
+     *
+     * @return bool :: Indication of if the write was successful
+     */
+    inline bool write(const std::string &fileName, const std::vector<LayerView> &layers) {
+        std::vector<LayerBlocks> entries;
+        for(const LayerView &view : layers) {
+            entries.push_back({view.rows, view.cols, view.act, {
+                {view.w, view.rows * view.cols * sizeof(float)},
+                {view.b, view.rows * sizeof(float)},
+            }});
+        }
+        return write_blocks(fileName, 0, entries);
+    }
+
+
+    /**
+     * @brief Write int8 layers (weights, per row scales, biases) to a binary model file
+     *
+     * @param fileName :: File to (over)write
+     * @param layers :: Layers to write
+     *
+     * @return bool :: Indication of if the write was successful
+     */
+    inline bool write_int8(const std::string &fileName, const std::vector<QuantizedLayerView> &layers) {
+        std::vector<LayerBlocks> entries;
+        for(const QuantizedLayerView &view : layers) {
+            entries.push_back({view.rows, view.cols, view.act, {
+                {view.w, view.rows * view.cols},
+                {view.scale, view.rows * sizeof(float)},
+                {view.b, view.rows * sizeof(float)},
+            }});
+        }
+        return write_blocks(fileName, FLAG_INT8, entries);
+    }
+
+
+    class MappedModel {
+        private:
+        mapped::MappedFile file;
+        std::vector<LayerView> layers;
+        std::vector<QuantizedLayerView> quantized;
+
+        public:
+        /**
+         * @brief Map a binary model file and validate its header and layer table
+         *
+         * Weights are not copied, the views point straight into the mapping.
+         * float32 files fill get_layers(), int8 files fill get_quantized_layers()
+         *
+         * @param fileName :: Binary model file
+         *
+         * @return bool :: Indication of if the model was mapped (false for text files, bad headers or big-endian hosts)
+         */
+        bool open(const std::string &fileName) {
+            this->layers.clear();
+            this->quantized.clear();
+            if(!host_little_endian() || !this->file.open(fileName)) {
+                return false;
+            }
+
+            const uint8_t *base = this->file.data();
+            size_t size = this->file.size();
+
+            if(size < HEADER_SIZE || std::memcmp(base, MAGIC, 4) != 0) {
+                this->file.close();
+                return false;
+            }
+
+            uint32_t version = get_u32(base + 4);
+            uint64_t count = get_u32(base + 8);
+            uint32_t flags = get_u32(base + 12);
+            if(version != VERSION || (flags != 0 && flags != FLAG_INT8) || get_u64(base + 16) != size || count == 0 ||
+               HEADER_SIZE + LAYER_ENTRY_SIZE * count > size) {
+                this->file.close();
+                return false;
+            }
+
+            size_t prevRows = 0;
+            for(size_t i = 0; i < count; i++) {
+                const uint8_t *entry = base + HEADER_SIZE + LAYER_ENTRY_SIZE * i;
+                LayerView view;
+                view.rows = get_u32(entry);
+                view.cols = get_u32(entry + 4);
+                view.act = get_u32(entry + 8);
+                uint64_t weightOffset = get_u64(entry + 16);
+                uint64_t biasOffset = get_u64(entry + 24);
+                uint64_t elementBytes = flags == FLAG_INT8 ? 1 : sizeof(float);
+
+                //Blocks must be aligned, inside the file, and chain input -> output
+                //Sizes are compared by division so huge rows/cols cannot wrap the products
+                bool valid = view.rows > 0 && view.cols > 0 &&
+                             weightOffset % ALIGNMENT == 0 && biasOffset % ALIGNMENT == 0 &&
+                             weightOffset <= size && biasOffset <= size &&
+                             view.cols <= (size - weightOffset) / elementBytes / view.rows &&
+                             view.rows <= (size - biasOffset) / sizeof(float) &&
+                             (i == 0 || view.cols == prevRows);
+
+                uint64_t scaleOffset = 0; //Only used by int8 files
+                if(valid && flags == FLAG_INT8) {
+                    scaleOffset = align_up(weightOffset + view.rows * view.cols);
+                    valid = scaleOffset <= size && view.rows <= (size - scaleOffset) / sizeof(float);
+                }
+                if(!valid) {
+                    this->layers.clear();
+                    this->quantized.clear();
+                    this->file.close();
+                    return false;
+                }
+                prevRows = view.rows;
+
+                if(flags == FLAG_INT8) {
+                    QuantizedLayerView qview;
+                    qview.rows = view.rows;
+                    qview.cols = view.cols;
+                    qview.act = view.act;
+                    qview.w = (const int8_t *)(base + weightOffset);
+                    qview.scale = (const float *)(base + scaleOffset);
+                    qview.b = (const float *)(base + biasOffset);
+                    this->quantized.push_back(qview);
+                } else {
+                    view.w = (const float *)(base + weightOffset);
+                    view.b = (const float *)(base + biasOffset);
+                    this->layers.push_back(view);
+                }
+            }
+            return true;
+        }
+
+
+        /**
+         * @brief Layers of the mapped model, valid until the model is closed or destroyed
+         *
+         * @return const std::vector<LayerView>& :: Layer views (empty if nothing is mapped or the file is int8)
+         */
+        const std::vector<LayerView> &get_layers(void) const {
+            return this->layers;
+        }
+
+        /**
+         * @brief Layers of a mapped int8 model, valid until the model is closed or destroyed
+         *
+         * @return const std::vector<QuantizedLayerView>& :: Layer views (empty if nothing is mapped or the file is float32)
+         */
+        const std::vector<QuantizedLayerView> &get_quantized_layers(void) const {
+            return this->quantized;
+        }
+
+
+        /**
+         * @brief Bytes of the mapped file
+         *
+         * @return size_t :: File size
+         */
+        size_t size(void) const {
+            return this->file.size();
+        }
+    };
+}
+
+
+
+#endif
@@ -1,8 +1,14 @@
+#ifndef PERCEPTRON_H
+#define PERCEPTRON_H
 #include <random>
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 #include <fstream>
 #include "./matrix.h++"
+#include "./model_file.h++"
+#include "./activation.h++"
+#include "./profile.h++"
 
 
 namespace perceptron {
@@ -23,6 +29,7 @@ namespace perceptron {
         ACTIVATION_FUNCTION act; //Activation function
         
         /* Backward */
+        //Only allocated on ParallelTrainer replicas, the network itself applies its update in the fused backward pass
         matrix::Matrix<float> dw;
         matrix::Matrix<float> db;
         
@@ -32,15 +39,426 @@ namespace perceptron {
         //Means Z doesnt need to be stored, only A
         
         //Preallocated for backpropagation
-        matrix::Matrix<float> dA;
+        //a and dZ have one column per sample in the batch
         matrix::Matrix<float> dZ; 
+
+#ifdef PERCEPTRON_PROFILE
+        profile::LayerProfile prof; //Recorded on whichever layers hold the state (network or replica)
+#endif
     };
+
+
+    /**
+     * @brief Epilogue computing act(z + bias) for an activation function
+     * 
+     * @param act :: Activation function
+     * 
+     * @return gemm::EpilogueFn :: Epilogue taking the biases as its row data
+     */
+    inline gemm::EpilogueFn epilogue_for(ACTIVATION_FUNCTION act) {
+        switch(act) {
+            case SIGMOID: {
+                return activation::bias_sigmoid;
+            }
+            case TANH: {
+                return activation::bias_tanh;
+            }
+            default: {
+                return activation::bias_relu;
+            }
+        }
+    }
+
+
+    /**
+     * @brief Epilogue computing Hadamard(dz, G'(a)) for an activation function
+     * 
+     * @param act :: Activation function
+     * 
+     * @return gemm::EpilogueFn :: Epilogue taking the activations as its cell data
+     */
+    inline gemm::EpilogueFn derivative_for(ACTIVATION_FUNCTION act) {
+        switch(act) {
+            case SIGMOID: {
+                return activation::derivative_sigmoid;
+            }
+            case TANH: {
+                return activation::derivative_tanh;
+            }
+            default: {
+                return activation::derivative_relu;
+            }
+        }
+    }
+
+
+    /**
+     * @brief dz = Hadamard(a - y, G'(a)) in one pass
+     * 
+     * @param act :: Activation function
+     * @param dz :: Output gradient, n values
+     * @param a :: Activated output, n values
+     * @param y :: Expected output, n values
+     * @param n :: Number of values
+     * 
+     * @return void :: None
+     */
+    inline void output_delta(ACTIVATION_FUNCTION act, float *dz, const float *a, const float *y, size_t n) {
+        switch(act) {
+            case RELU: {
+                activation::output_delta_relu(dz, a, y, n);
+                break;
+            }
+            case SIGMOID: {
+                activation::output_delta_sigmoid(dz, a, y, n);
+                break;
+            }
+            case TANH: {
+                activation::output_delta_tanh(dz, a, y, n);
+                break;
+            }
+        }
+        return;
+    }
     
     class Perceptron {
         private:
         matrix::Matrix<float> input; //Input to layer
+        matrix::Matrix<float> target; //Expected output for single sample backward
         std::vector<Layer> layers;
 
+
+        /**
+         * @brief Resize the per-sample buffers of the network to hold a batch
+         * 
+         * Buffers keep their capacity, so switching between batch sizes only allocates the first time a size is seen
+         * 
+         * @param batchSize :: Number of samples (columns) per batch
+         * 
+         * @return void :: None
+         */
+        void resize_batch(size_t batchSize) {
+            if(this->input.get_cols() == batchSize) {
+                return;
+            }
+
+            this->input.resize(this->input.get_rows(), batchSize);
+            resize_state(this->layers, batchSize);
+            return;
+        }
+
+
+        /**
+         * @brief Resize the per-sample buffers (a, dZ) of a set of layers
+         * 
+         * @param state :: Layers to resize (this->layers or a replica)
+         * @param batchSize :: Number of samples (columns) per batch
+         * 
+         * @return void :: None
+         */
+        static void resize_state(std::vector<Layer> &state, size_t batchSize) {
+            for(Layer &layer : state) {
+                layer.a.resize(layer.a.get_rows(), batchSize);
+                layer.dZ.resize(layer.dZ.get_rows(), batchSize);
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Run every layer on an input batch
+         * 
+         * Weights are always read from this network. Activations are written to state,
+         * which is either this->layers or a per-thread replica from make_replica.
+         * Bias and activation are applied by the gemm epilogue while each output tile is still in cache
+         * 
+         * @param x :: Input batch (inputs x batch size)
+         * @param state :: Layers receiving the activations
+         * 
+         * @return void :: None
+         */
+        void forward_layers(matrix::Matrix<float> &x, std::vector<Layer> &state) {
+            matrix::Matrix<float> *inputMatrix = &x;
+            
+            for(size_t i = 0; i < this->layers.size(); i++) {
+                Layer &layer = this->layers[i];
+                matrix::Matrix<float> &a = state[i].a;
+                size_t rows = layer.w.get_rows();
+                size_t cols = layer.w.get_cols();
+                size_t batchSize = inputMatrix->get_cols();
+                PERCEPTRON_PROFILE_SCOPE(state[i].prof.forward);
+
+                //A = G(W * X + B)
+                gemm::Epilogue epilogue = {epilogue_for(layer.act), layer.b.get_data(), NULL};
+                gemm::multiply(false, false, rows, batchSize, cols, layer.w.get_data(), cols,
+                               inputMatrix->get_data(), batchSize, a.get_data(), batchSize, 1.0f, false, &epilogue);
+                inputMatrix = &a;
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Compute dZ, dW and dB for every layer after forward_layers on the same state
+         * 
+         * dW and dB are summed over the batch, they are not averaged.
+         * Used by ParallelTrainer, which has to reduce the gradients of its replicas before updating
+         * 
+         * @param x :: Input batch passed to forward_layers
+         * @param y :: Expected network output (outputs x batch size)
+         * @param state :: Layers holding the activations, receives the gradients
+         * 
+         * @return void :: None
+         */
+        void backward_layers(matrix::Matrix<float> &x, matrix::Matrix<float> &y, std::vector<Layer> &state) {
+
+            for(size_t i = this->layers.size() - 1; i != SIZE_MAX; i--) {
+                Layer &layer = state[i];
+
+                matrix::Matrix<float> *aPrev = NULL;
+                if(i == 0) {
+                    aPrev = &x;
+                } else {
+                    aPrev = &(state[i - 1].a);
+                }
+
+                this->layer_delta(i, y, state);
+                PERCEPTRON_PROFILE_SCOPE(layer.prof.backward, false);
+
+                //dW = dZ * aPrev^T (summed over the batch)
+                layer.dw.multiply(layer.dZ, *aPrev, false, true);
+
+                //dB = dZ (summed over the batch)
+                layer.db.sum_cols(layer.dZ);
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Compute dZ of one layer, applying the activation derivative in the pass that writes dZ
+         * 
+         * Back layer: dZ = Hadamard(A - y, G'(A)). Hidden layer: dZ = Hadamard(wNext^T * dZNext, G'(A))
+         * 
+         * @param i :: Layer index
+         * @param y :: Expected network output (outputs x batch size)
+         * @param state :: Layers holding the activations, dZ of layer i + 1 must already be computed
+         * 
+         * @return void :: None
+         */
+        void layer_delta(size_t i, matrix::Matrix<float> &y, std::vector<Layer> &state) {
+            Layer &layer = state[i];
+            PERCEPTRON_PROFILE_SCOPE(layer.prof.backward);
+            size_t rows = layer.a.get_rows();
+            size_t batchSize = layer.a.get_cols();
+
+            if(i == this->layers.size() - 1) { //Back layer
+                output_delta(this->layers[i].act, layer.dZ.get_data(), layer.a.get_data(), y.get_data(), rows * batchSize);
+            } else { //Hidden layer, G'(A) runs on each tile of wNext^T * dZNext while it is in cache
+                matrix::Matrix<float> &wNext = this->layers[i + 1].w;
+                gemm::Epilogue epilogue = {derivative_for(this->layers[i].act), NULL, layer.a.get_data()};
+                gemm::multiply(true, false, rows, batchSize, wNext.get_rows(), wNext.get_data(), wNext.get_cols(),
+                               state[i + 1].dZ.get_data(), batchSize, layer.dZ.get_data(), batchSize, 1.0f, false, &epilogue);
+            }
+            return;
+        }
+
+
+        /**
+         * @brief SGD step on one layer straight from its dZ, without materializing dW
+         * 
+         * W = W - step * dZ * aPrev^T runs as a single accumulating gemm, B = B - step * rowsum(dZ)
+         * 
+         * @param l :: Layer index
+         * @param aPrev :: Input to the layer (inputs x batch size)
+         * @param step :: Learning rate divided by the batch size
+         * 
+         * @return void :: None
+         */
+        void update_layer(size_t l, matrix::Matrix<float> &aPrev, float step) {
+            Layer &layer = this->layers[l];
+            PERCEPTRON_PROFILE_SCOPE(layer.prof.backward, false); //The call was counted by layer_delta
+            size_t rows = layer.w.get_rows();
+            size_t cols = layer.w.get_cols();
+            size_t batchSize = layer.dZ.get_cols();
+            const float *dz = layer.dZ.get_data();
+
+            gemm::multiply(false, true, rows, cols, batchSize, dz, batchSize, aPrev.get_data(), batchSize,
+                           layer.w.get_data(), cols, -step, true);
+
+            float *b = layer.b.get_data();
+            for(size_t i = 0; i < rows; i++) {
+                const float *row = dz + i * batchSize;
+                float sum = 0;
+                for(size_t j = 0; j < batchSize; j++) {
+                    sum += row[j];
+                }
+                b[i] -= step * sum;
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Backpropagate and update every layer in one sweep from the back of the network
+         * 
+         * Layer i + 1 is only updated once dZ of layer i has been computed from its old weights,
+         * so the result matches backward_layers followed by apply_gradients
+         * 
+         * @param x :: Input batch passed to forward_layers
+         * @param y :: Expected network output (outputs x batch size)
+         * @param step :: Learning rate divided by the batch size
+         * 
+         * @return void :: None
+         */
+        void backward_fused(matrix::Matrix<float> &x, matrix::Matrix<float> &y, float step) {
+            size_t last = this->layers.size() - 1;
+            this->layer_delta(last, y, this->layers);
+
+            for(size_t i = last; i > 0; i--) {
+                this->layer_delta(i - 1, y, this->layers);
+                this->update_layer(i, this->layers[i - 1].a, step);
+            }
+            this->update_layer(0, x, step);
+            return;
+        }
+
+
+        /**
+         * @brief Gradient descent step on the weights of this network
+         * 
+         * @param grads :: Layers holding dW and dB (this->layers or a replica)
+         * @param step :: Learning rate, divided by the batch size when the gradients are sums
+         * 
+         * @return void :: None
+         */
+        void apply_gradients(std::vector<Layer> &grads, float step) {
+            for(size_t l = 0; l < this->layers.size(); l++) {
+                Layer &layer = this->layers[l];
+                Layer &grad = grads[l];
+
+                //W -= lr * dW
+                for(size_t i = 0; i < layer.w.get_rows(); i++) {
+                    for(size_t j = 0; j < layer.w.get_cols(); j++) {
+                        layer.w.at(i, j) -= step * grad.dw.at(i, j);
+                    }
+                }
+
+                for(size_t i = 0; i < layer.b.get_rows(); i++) {
+                    layer.b.at(i, 0) -= step * grad.db.at(i, 0);
+                }
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Allocate activation and gradient buffers shaped like this network, without weights
+         * 
+         * Used by ParallelTrainer so each thread has private buffers while sharing the weights
+         * 
+         * @param batchSize :: Columns for the per-sample buffers
+         * 
+         * @return std::vector<Layer> :: Replica layers (w and b are empty)
+         */
+        std::vector<Layer> make_replica(size_t batchSize) {
+            std::vector<Layer> replica(this->layers.size());
+
+            for(size_t i = 0; i < this->layers.size(); i++) {
+                size_t neuronsNext = this->layers[i].w.get_rows();
+                size_t neuronsCurrent = this->layers[i].w.get_cols();
+
+                replica[i].act = this->layers[i].act;
+                replica[i].a = matrix::Matrix<float>(neuronsNext, batchSize);
+                replica[i].dZ = matrix::Matrix<float>(neuronsNext, batchSize);
+                replica[i].dw = matrix::Matrix<float>(neuronsNext, neuronsCurrent);
+                replica[i].db = matrix::Matrix<float>(neuronsNext, 1);
+            }
+            return replica;
+        }
+
+
+        /**
+         * @brief Mean of the squared error between an output batch and its expected values
+         * 
+         * @param out :: Network output (outputs x batch size)
+         * @param y :: Expected output (same dimensions as out)
+         * 
+         * @return float :: MSE
+         */
+        static float mean_squared_error(matrix::Matrix<float> &out, matrix::Matrix<float> &y) {
+            float mse = 0;
+            for(size_t i = 0; i < out.get_rows(); i++) {
+                for(size_t j = 0; j < out.get_cols(); j++) {
+                    float diff = y.at(i, j) - out.at(i, j);
+                    mse += diff * diff;
+                }
+            }
+
+            mse /= (float)(out.get_rows() * out.get_cols());
+            return mse;
+        }
+
+
+        /**
+         * @brief Column stack a run of samples into batch matrices
+         * 
+         * @param inputs :: Vector of input vectors
+         * @param targets :: Vector of target vectors (same order as inputs)
+         * @param order :: Sample order (shuffled indices)
+         * @param start :: First position in order to take
+         * @param x :: Receives the inputs (inputs x n), resized
+         * @param y :: Receives the targets (outputs x n), resized
+         * @param n :: Number of samples to take
+         * 
+         * @return void :: None
+         */
+        static void gather_batch(std::vector<std::vector<float>> &inputs, std::vector<std::vector<float>> &targets,
+                                 std::vector<size_t> &order, size_t start, size_t n,
+                                 matrix::Matrix<float> &x, matrix::Matrix<float> &y) {
+            size_t nIn = x.get_rows();
+            size_t nOut = y.get_rows();
+            x.resize(nIn, n);
+            y.resize(nOut, n);
+
+            for(size_t j = 0; j < n; j++) {
+                std::vector<float> &sampleIn = inputs[order[start + j]];
+                std::vector<float> &sampleOut = targets[order[start + j]];
+
+                if(sampleIn.size() != nIn || sampleOut.size() != nOut) {
+                    throw std::invalid_argument("Network was passed incompatable sample dimension\n");
+                }
+                for(size_t k = 0; k < nIn; k++) {
+                    x.at(k, j) = sampleIn[k];
+                }
+                for(size_t k = 0; k < nOut; k++) {
+                    y.at(k, j) = sampleOut[k];
+                }
+            }
+            return;
+        }
+
+        /**
+         * @brief Allocate the forward/backward buffers of a layer to match its weights (batch size 1)
+         * 
+         * dW and dB are not allocated, backward_fused updates the weights in place
+         * 
+         * @param layer :: Layer with w set
+         * 
+         * @return void :: None
+         */
+        static void allocate_buffers(Layer &layer) {
+            size_t neuronsNext = layer.w.get_rows();
+
+            layer.a = matrix::Matrix<float>(neuronsNext, 1);
+            layer.dZ = matrix::Matrix<float>(neuronsNext, 1);
+            return;
+        }
+
+        friend class ParallelTrainer;
+        friend class InferenceModel;
+        friend class QuantizedModel;
+
         public:
         /**
          * @brief Construct a neural network
@@ -75,13 +493,8 @@ namespace perceptron {
                 //Garuntees copy elision
                 layer.w = matrix::Matrix<float>(neuronsNext, neuronsCurrent);
                 layer.b = matrix::Matrix<float>(neuronsNext, 1);
-                layer.a = matrix::Matrix<float>(neuronsNext, 1);
-                layer.dw = matrix::Matrix<float>(neuronsNext, neuronsCurrent);
-                layer.db = matrix::Matrix<float>(neuronsNext, 1);
                 layer.act = act;
-                
-                layer.dA = matrix::Matrix<float>(neuronsCurrent, 1);
-                layer.dZ = matrix::Matrix<float>(neuronsNext, 1);
+                allocate_buffers(layer);
 
 
                 //Randomise layer
@@ -133,35 +546,34 @@ namespace perceptron {
          */
         const std::vector<float> &forward(std::vector<float> &x) {
             
-            if(x.size() != this->input.get_vector().size()) {
+            if(x.size() != this->input.get_rows()) {
                 throw std::invalid_argument("Network was passed incompatable x dimension\n");
             }
             
+            this->resize_batch(1);
             this->input.fill_vector(x);
-            matrix::Matrix<float> *inputMatrix = &(this->input);
-            
-            for(Layer &layer : this->layers) {
-                layer.a.multiply(layer.w, *inputMatrix, false, false);
-                layer.a.add(layer.b);
-                
-                switch(layer.act) {
-                    case RELU: {
-                        layer.a.activate_relu();   
-                        break;
-                    }
-                    case SIGMOID: {
-                        layer.a.activate_sigmoid();
-                        break;
-                    }
-                    case TANH: {
-                        layer.a.activate_tanh();
-                        break;
-                    }
-                }
-                inputMatrix = &(layer.a);
-            }            
+            this->forward_layers(this->input, this->layers);
             return this->layers.back().a.get_vector();
         }
+
+        /**
+         * @brief Forward pass on a mini-batch of samples
+         * 
+         * @param &x :: Input matrix (copied to internal network). One sample per column, so dimensions are inputs x batch size
+         * 
+         * @return matrix::Matrix<float>& :: Reference to internal network output (outputs x batch size)
+         */
+        const matrix::Matrix<float> &forward_batch(matrix::Matrix<float> &x) {
+
+            if(x.get_rows() != this->input.get_rows() || x.get_cols() == 0) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+
+            this->resize_batch(x.get_cols());
+            this->input.fill_vector(x.get_vector());
+            this->forward_layers(this->input, this->layers);
+            return this->layers.back().a;
+        }
        
         /**
          * @brief Retrieve the MSE for the last forward pass
@@ -186,6 +598,23 @@ namespace perceptron {
             return mse;
         }
 
+        /**
+         * @brief Retrieve the MSE for the last batched forward pass, averaged over the batch
+         * 
+         * @param &y :: Expected output of network (outputs x batch size)
+         * 
+         * @return float :: MSE
+         */
+        float mse_batch(matrix::Matrix<float> &y) {
+            matrix::Matrix<float> &out = this->layers.back().a;
+
+            if(y.get_rows() != out.get_rows() || y.get_cols() != out.get_cols()) {
+                throw std::invalid_argument("Network was passed incompatable y dimension\n");
+            }
+
+            return mean_squared_error(out, y);
+        }
+
         /**
          * @brief Backpropagation implementation. Batch size == 1
          * 
@@ -196,173 +625,164 @@ namespace perceptron {
          */
         void backward(std::vector<float> &y, float lr) {
             
-            if(y.size() != this->layers.back().a.get_vector().size()) {
+            if(y.size() != this->layers.back().a.get_rows()) {
                 throw std::invalid_argument("Network was passed incompatable y dimension\n");
             }
 
-            //Compute gradients dZ, dW, dB
-            for(size_t i = this->layers.size() - 1; i != SIZE_MAX; i--) {
-                Layer &layer = this->layers[i];
-
-                matrix::Matrix<float> *aPrev = NULL;
-                if(i == 0) {
-                    aPrev = &(this->input);
-                } else {
-                    aPrev = &(this->layers[i - 1].a);
-                }
-
-                //Find dZ
-                if(i == this->layers.size() - 1) { //Back layer
-                    //dA = (A - y), dZ = Hadamard(dA, G'(A))
-                    for(size_t j = 0; j < layer.dZ.get_rows(); j++) {
-                        layer.dZ.at(j, 0) = layer.a.at(j, 0) - y[j];
-                    }
-                } else { //Hidden layer
-                    //dZ = wNext^T * dZNext
-                    Layer &next = this->layers[i + 1];
-                    layer.dZ.multiply(next.w, next.dZ, true, false);
-                }
-
-                //Use dB as temp buffer, gets overwritten anyway and has same size
-                //dB = G'(A)
-                //dZ = hadamard(dZ, dB)
-                for(size_t j = 0; j < layer.db.get_rows(); j++) {
-                    layer.db.at(j, 0) = layer.a.at(j, 0);
-                }
-
-                switch(layer.act) {
-                    case RELU: {
-                        layer.db.activate_derivative_relu();
-                        break;
-                    }
-                    case SIGMOID: {
-                        layer.db.activate_derivative_sigmoid();
-                        break;
-                    }
-                    case TANH: {
-                        layer.db.activate_derivative_tanh();
-                        break;
-                    }
-                }
-                layer.dZ.hadamard(layer.db);
+            this->target.resize(y.size(), 1);
+            this->target.fill_vector(y);
+            this->backward_batch(this->target, lr);
+            return;
+        }
 
-                //dW = dZ * aPrev^T
-                layer.dw.multiply(layer.dZ, *aPrev, false, true);
+        /**
+         * @brief Backpropagation on the last batched forward pass. Gradients are averaged over the batch
+         * 
+         * @param y :: Expected network output (outputs x batch size)
+         * @param lr :: Learning rate during back propagation
+         * 
+         * @return void :: None 
+         */
+        void backward_batch(matrix::Matrix<float> &y, float lr) {
+            matrix::Matrix<float> &out = this->layers.back().a;
 
-                //dB = dZ
-                for(size_t j = 0; j < layer.db.get_rows(); j++) {
-                    layer.db.at(j, 0) = layer.dZ.at(j, 0);
-                }
+            if(y.get_rows() != out.get_rows() || y.get_cols() != out.get_cols()) {
+                throw std::invalid_argument("Network was passed incompatable y dimension\n");
             }
-            
-            //Second pass to update params
-            for(Layer &layer : this->layers) {
-                //W -= lr * dW
-                for(size_t i = 0; i < layer.w.get_rows(); i++) {
-                    for(size_t j = 0; j < layer.w.get_cols(); j++) {
-                        layer.w.at(i, j) -= lr * layer.dw.at(i, j);
-                    }
-                }
 
-                for(size_t i = 0; i < layer.b.get_rows(); i++) {
-                    layer.b.at(i, 0) -= lr * layer.db.at(i, 0);
-                }
-            }
+            //dZ and the update of each layer in one sweep, averaging the summed gradients
+            this->backward_fused(this->input, y, lr / (float)(y.get_cols()));
             return;
         }
 
         /**
-         * @brief Save a network into a file (weights + biases only)
+         * @brief One mini-batch gradient step: forward_batch, mse_batch then backward_batch
+         * 
+         * @param x :: Input batch (inputs x batch size)
+         * @param y :: Expected output (outputs x batch size)
+         * @param lr :: Learning rate
+         * 
+         * @return float :: MSE of the batch before the update
+         */
+        float train_batch(matrix::Matrix<float> &x, matrix::Matrix<float> &y, float lr) {
+            this->forward_batch(x);
+            float loss = this->mse_batch(y);
+            this->backward_batch(y, lr);
+            return loss;
+        }
+
+        /**
+         * @brief Save a network into a binary model file (weights + biases only). See model_file.h++ for the layout
          * 
          * @param fileName :: File name to save the network state too
          * 
          * @return bool :: Indication of if save was successful
          */
         bool save_file(std::string fileName) {
-            //TODO: Should work on making this not reopen a file many, many times
+            std::vector<modelfile::LayerView> views;
+            views.reserve(this->layers.size());
 
-            std::ofstream file(fileName); //Clear file
-            if(!file) {
+            for(Layer &layer : this->layers) {
+                modelfile::LayerView view;
+                view.rows = layer.w.get_rows();
+                view.cols = layer.w.get_cols();
+                view.act = (uint32_t)layer.act;
+                view.w = layer.w.get_vector().data();
+                view.b = layer.b.get_vector().data();
+                views.push_back(view);
+            }
+
+            return modelfile::write(fileName, views);
+        }
+
+        /**
+         * @brief Read a network from a file. Binary model files are mapped, older text files are parsed
+         * 
+         * The network is left unchanged if the file can't be read
+         * 
+         * @param fileName :: File name to load the network state from
+         * 
+         * @return bool :: Indication of if load was successful
+         */
+        bool read_file(std::string fileName) {
+            if(!modelfile::is_binary(fileName)) {
+                return read_file_text(fileName);
+            }
+
+            modelfile::MappedModel model;
+            if(!model.open(fileName) || model.get_layers().empty()) { //Int8 files only load into QuantizedModel
                 return false;
             }
-            file.close();
-            
-            for(Layer layer : this->layers) {
-                std::ofstream file(fileName, std::ios::app); //Write activation function
-                if(!file) {
-                    return false;
-                }
-                file << layer.act << "\n";
-                file.close();
 
-                if(!layer.w.append_to_file(fileName)) {
+            std::vector<Layer> loaded(model.get_layers().size());
+            for(size_t i = 0; i < loaded.size(); i++) {
+                const modelfile::LayerView &view = model.get_layers()[i];
+                if(view.act > TANH) {
                     return false;
                 }
 
-                if(!layer.b.append_to_file(fileName)) {
-                    return false;
-                }
+                Layer &layer = loaded[i];
+                layer.w = matrix::Matrix<float>(view.rows, view.cols, view.w);
+                layer.b = matrix::Matrix<float>(view.rows, 1, view.b);
+                layer.act = (ACTIVATION_FUNCTION)view.act;
+                allocate_buffers(layer);
             }
 
+            this->layers.swap(loaded);
+            this->input = matrix::Matrix<float>(this->layers.front().w.get_cols(), 1);
             return true;
         }
 
         /**
-         * @brief Read a network from a file
+         * @brief Read a network from the older text format (activation, then weight and bias matrices per layer)
+         * 
+         * Kept so text models can be migrated: read_file_text then save_file
          * 
          * @param fileName :: File name to load the network state from
          * 
-         * @return bool :: Indication of if save was successful
+         * @return bool :: Indication of if load was successful
          */
-        bool read_file(std::string fileName) {
-            //need to improve error handling
+        bool read_file_text(std::string fileName) {
             std::ifstream file(fileName);
             if(!file) {
                 return false;
             }
             
-            layers.clear();
-            
-            while(1) {
-                std::string str;
-                if(!std::getline(file, str)) {
-                    break;
-                }
+            std::vector<Layer> loaded;
+            try {
+                while(1) {
+                    std::string str;
+                    if(!std::getline(file, str)) {
+                        break;
+                    }
 
-                ACTIVATION_FUNCTION act = (ACTIVATION_FUNCTION)std::stoi(str);
+                    int act = std::stoi(str);
+                    if(act < RELU || act > TANH) {
+                        return false;
+                    }
 
-                //Need to reduce redundant copies here
-                matrix::Matrix<float> weight;
-                if(!weight.read_float_file_fstream(file)) {
-                    return false;
-                }
+                    loaded.emplace_back();
+                    Layer &layer = loaded.back();
+                    layer.act = (ACTIVATION_FUNCTION)act;
 
-                matrix::Matrix<float> bias;
-                if(!bias.read_float_file_fstream(file)) {
-                    return false;
+                    if(!layer.w.read_float_file_fstream(file)) {
+                        return false;
+                    }
+                    if(!layer.b.read_float_file_fstream(file)) {
+                        return false;
+                    }
+                    allocate_buffers(layer);
                 }
-
-                Layer layer = {
-                    .w = weight,
-                    .b = bias,
-                    .act = act,
-                };
-                size_t neuronsNext = layer.w.get_rows();
-                size_t neuronsCurrent = layer.w.get_cols();
-                layer.a = matrix::Matrix<float>(neuronsNext, 1);
-                layer.dw = matrix::Matrix<float>(neuronsNext, neuronsCurrent);
-                layer.db = matrix::Matrix<float>(neuronsNext, 1);
-                layer.dA = matrix::Matrix<float>(neuronsCurrent, 1);
-                layer.dZ = matrix::Matrix<float>(neuronsNext, 1);
-
-                layers.push_back(layer);
+            } catch(const std::exception &) { //stoi/stof on a malformed file
+                return false;
             }
             
-            if(layers.empty()) {
+            if(loaded.empty()) {
                 return false;
             }
             
-            this->input = matrix::Matrix<float>(layers.front().w.get_cols(), 1);
+            this->layers.swap(loaded);
+            this->input = matrix::Matrix<float>(this->layers.front().w.get_cols(), 1);
             return true;
         }
 
@@ -376,7 +796,7 @@ namespace perceptron {
             std::cout << "\nInput layer: " << input.get_rows() << " neurons\n";
             
             for(size_t i = 0; i < layers.size(); i++) {
-                const char* actName;
+                const char* actName = "Unknown";
                 switch(layers[i].act) {
                     case RELU:
                         actName = "ReLU";
@@ -431,7 +851,8 @@ namespace perceptron {
         /**
          * @brief Train on multiple samples for multiple epochs
          * 
-         * Runs forward/backward on each sample one at a time
+         * Samples are shuffled every epoch then split into mini-batches
+         * Each mini-batch runs one forward_batch/backward_batch step
          * Prints loss every 100 epochs if verbose is true
          * 
          * @param inputs :: Vector of input vectors
@@ -439,18 +860,46 @@ namespace perceptron {
          * @param epochs :: Number of complete passes through the training data
          * @param lr :: Learning rate
          * @param verbose :: Print loss updates if true
+         * @param batchSize :: Samples per gradient step. The last batch of an epoch may be smaller
          */
         void train(std::vector<std::vector<float>> &inputs,
                    std::vector<std::vector<float>> &targets,
-                   int epochs, float lr, bool verbose = true) {
+                   int epochs, float lr, bool verbose = true, size_t batchSize = 1) {
+
+            if(inputs.size() != targets.size()) {
+                throw std::invalid_argument("Incompatable input and target vector dimensions\n");
+            }
+            if(batchSize == 0) {
+                throw std::invalid_argument("Batch size must be at least 1\n");
+            }
+            if(inputs.empty()) {
+                return;
+            }
+
+            size_t nIn = this->input.get_rows();
+            size_t nOut = this->layers.back().a.get_rows();
+
+            //Preallocated once, columns get filled from shuffled samples
+            matrix::Matrix<float> x(nIn, batchSize);
+            matrix::Matrix<float> y(nOut, batchSize);
+
+            std::vector<size_t> order(inputs.size());
+            for(size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::mt19937 rng(std::random_device{}());
             
             for(int epoch = 0; epoch < epochs; epoch++) {
                 float totalLoss = 0.0f;
+                std::shuffle(order.begin(), order.end(), rng);
                 
-                for(size_t i = 0; i < inputs.size(); i++) {
-                    forward(inputs[i]);
-                    totalLoss += mse(targets[i]);
-                    backward(targets[i], lr);
+                for(size_t start = 0; start < order.size(); start += batchSize) {
+                    size_t n = std::min(batchSize, order.size() - start);
+                    gather_batch(inputs, targets, order, start, n, x, y);
+
+                    forward_batch(x);
+                    totalLoss += mse_batch(y) * n;
+                    backward_batch(y, lr);
                 }
                 
                 totalLoss /= inputs.size();
@@ -528,10 +977,39 @@ namespace perceptron {
             
             return layers[layerIdx].a.get_vector();
         }
-    };
-}
 
+#ifdef PERCEPTRON_PROFILE
+        /**
+         * @brief Time and call counts of a layer since construction, read_file or reset_profile
+         * 
+         * Only covers work done on this network's own buffers, not ParallelTrainer replicas
+         * 
+         * @param layerIdx :: Layer index (0 = first hidden layer)
+         * 
+         * @return const profile::LayerProfile & :: Forward and backward counters
+         */
+        const profile::LayerProfile &get_profile(size_t layerIdx) {
+            if(layerIdx >= this->layers.size()) {
+                throw std::out_of_range("Bad layer index");
+            }
+            return this->layers[layerIdx].prof;
+        }
 
+        /**
+         * @brief Zero the profiling counters of every layer
+         * 
+         * @return void :: None
+         */
+        void reset_profile() {
+            for(Layer &layer : this->layers) {
+                layer.prof = profile::LayerProfile();
+            }
+            return;
+        }
+#endif
+    };
+}
 
 
 
+#endif
@@ -0,0 +1,73 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <cstdint>
+#include <chrono>
+
+
+/**
+ * NOTE: Per-layer profiling
+ * Compile with -DPERCEPTRON_PROFILE (or define it before the first include) to record the time and call count
+ * of every layer's forward and backward work. Without the macro the counters are not members of Layer and
+ * PERCEPTRON_PROFILE_SCOPE expands to nothing, so there is no cost at all
+ *
+ * Every translation unit of a program has to agree on the macro, since it changes the layout of Layer
+ */
+
+
+#ifdef PERCEPTRON_PROFILE
+
+namespace profile {
+
+    typedef struct Counter {
+        uint64_t calls = 0;
+        uint64_t ns = 0; //Total wall time
+    } Counter;
+
+    typedef struct LayerProfile {
+        Counter forward;  //W * X + B and the activation
+        Counter backward; //dZ, then the weight update (or dW/dB on ParallelTrainer replicas)
+    } LayerProfile;
+
+
+    /**
+     * @brief Adds the lifetime of the scope to a counter
+     */
+    class Scope {
+        private:
+        Counter &counter;
+        bool count;
+        std::chrono::steady_clock::time_point start;
+
+        public:
+        /**
+         * @brief Start timing
+         *
+         * @param counter :: Counter receiving the time
+         * @param count :: Also increment calls (false when one call is split over several scopes)
+         */
+        Scope(Counter &counter, bool count = true) : counter(counter), count(count), start(std::chrono::steady_clock::now()) {}
+
+        ~Scope() {
+            auto end = std::chrono::steady_clock::now();
+            this->counter.ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - this->start).count();
+            this->counter.calls += this->count;
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+}
+
+#define PERCEPTRON_PROFILE_CONCAT_(a, b) a##b
+#define PERCEPTRON_PROFILE_CONCAT(a, b) PERCEPTRON_PROFILE_CONCAT_(a, b)
+#define PERCEPTRON_PROFILE_SCOPE(...) profile::Scope PERCEPTRON_PROFILE_CONCAT(profileScope, __LINE__)(__VA_ARGS__)
+
+#else
+
+#define PERCEPTRON_PROFILE_SCOPE(...)
+
+#endif
+
+
+
+#endif
@@ -0,0 +1,675 @@
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "./perceptron.h++"
+
+
+/**
+ * NOTE: Post-training int8 inference
+ * Weights are quantized once per output row (scale = largest |w| in the row / 127), activations once per
+ * sample before every layer. Dot products run on int8 and accumulate in int32, then a single pass turns the
+ * accumulator back into floats, adds the bias and applies the activation
+ *
+ * CPUs with AVX-512 VNNI multiply unsigned by signed bytes, so there the input is offset by 128 to make it
+ * unsigned and 128 * (sum of the weight row) is subtracted again afterwards
+ *
+ * Weights take a quarter of the fp32 memory and there are no gradient or backward buffers at all.
+ * Expect a small accuracy drop (usually well under a percent on classification)
+ */
+
+
+namespace quant {
+
+    //y = W * x for int8 W (rows x cols, row major) and x (cols), accumulated in int32
+    //rowSums holds the sum of every row of W, only needed by kernels that offset x to unsigned
+    typedef void (*GemvS8Kernel)(size_t rows, size_t cols, const int8_t *w, const int8_t *x, const int32_t *rowSums, int32_t *y);
+
+
+    /**
+     * @brief Symmetric int8 quantization of contiguous floats
+     *
+     * @param x :: Values to quantize
+     * @param n :: Number of values
+     * @param out :: n quantized values (-127 to 127)
+     *
+     * @return float :: Scale, x[i] ~= scale * out[i] (0 if every value is 0)
+     */
+    inline float quantize(const float *x, size_t n, int8_t *out) {
+        //Non negative floats order the same as their bit patterns, and an integer max vectorizes
+        uint32_t largestBits = 0;
+        for(size_t i = 0; i < n; i++) {
+            uint32_t bits;
+            std::memcpy(&bits, x + i, 4);
+            largestBits = std::max(largestBits, bits & 0x7FFFFFFFu);
+        }
+        float largest;
+        std::memcpy(&largest, &largestBits, 4);
+
+        if(largest == 0.0f) {
+            std::fill(out, out + n, 0);
+            return 0.0f;
+        }
+
+        float inverse = 127.0f / largest;
+        for(size_t i = 0; i < n; i++) {
+            float v = x[i] * inverse;
+            out[i] = (int8_t)(int32_t)(v + (v >= 0.0f ? 0.5f : -0.5f)); //Round to nearest, |v| <= 127
+        }
+        return largest / 127.0f;
+    }
+
+
+    /**
+     * @brief Quantize every column of a batch on its own
+     *
+     * @param x :: Values (n x batch, row major), one sample per column
+     * @param n :: Values per sample
+     * @param batch :: Number of samples
+     * @param out :: Quantized samples, one after the other (batch x n)
+     * @param scales :: Scale of every sample
+     *
+     * @return void :: None
+     */
+    inline void quantize_columns(const float *x, size_t n, size_t batch, int8_t *out, float *scales) {
+        if(batch == 1) {
+            scales[0] = quantize(x, n, out);
+            return;
+        }
+
+        //Walk x row by row so the reads stay contiguous
+        std::fill(scales, scales + batch, 0.0f);
+        for(size_t i = 0; i < n; i++) {
+            for(size_t j = 0; j < batch; j++) {
+                scales[j] = std::max(scales[j], std::abs(x[i * batch + j]));
+            }
+        }
+        for(size_t j = 0; j < batch; j++) {
+            float inverse = scales[j] == 0.0f ? 0.0f : 127.0f / scales[j];
+            scales[j] /= 127.0f;
+            for(size_t i = 0; i < n; i++) {
+                float v = x[i * batch + j] * inverse;
+                out[j * n + i] = (int8_t)(int32_t)(v + (v >= 0.0f ? 0.5f : -0.5f));
+            }
+        }
+        return;
+    }
+
+
+    inline void gemv_s8_scalar(size_t rows, size_t cols, const int8_t *w, const int8_t *x, const int32_t *rowSums, int32_t *y) {
+        (void)rowSums;
+        for(size_t i = 0; i < rows; i++) {
+            const int8_t *row = w + i * cols;
+            int32_t sum = 0;
+            for(size_t k = 0; k < cols; k++) {
+                sum += (int32_t)row[k] * (int32_t)x[k];
+            }
+            y[i] = sum;
+        }
+        return;
+    }
+
+#ifdef GEMM_X86
+    __attribute__((target("avx2")))
+    inline int32_t hsum_epi32_avx2(__m256i v) {
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+    }
+
+    //Widen 16 int8 to int16 then madd: pairs of products summed straight into int32 lanes
+    __attribute__((target("avx2")))
+    inline void gemv_s8_avx2(size_t rows, size_t cols, const int8_t *w, const int8_t *x, const int32_t *rowSums, int32_t *y) {
+        (void)rowSums;
+        size_t i = 0;
+        //4 rows at a time share every widened load of x
+        for(; i + 4 <= rows; i += 4) {
+            const int8_t *r0 = w + i * cols;
+            const int8_t *r1 = r0 + cols;
+            const int8_t *r2 = r1 + cols;
+            const int8_t *r3 = r2 + cols;
+            __m256i s0 = _mm256_setzero_si256();
+            __m256i s1 = _mm256_setzero_si256();
+            __m256i s2 = _mm256_setzero_si256();
+            __m256i s3 = _mm256_setzero_si256();
+
+            size_t k = 0;
+            for(; k + 16 <= cols; k += 16) {
+                __m256i xv = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(x + k)));
+                s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(r0 + k))), xv));
+                s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(r1 + k))), xv));
+                s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(r2 + k))), xv));
+                s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(r3 + k))), xv));
+            }
+            int32_t t0 = hsum_epi32_avx2(s0), t1 = hsum_epi32_avx2(s1), t2 = hsum_epi32_avx2(s2), t3 = hsum_epi32_avx2(s3);
+            for(; k < cols; k++) {
+                t0 += (int32_t)r0[k] * x[k];
+                t1 += (int32_t)r1[k] * x[k];
+                t2 += (int32_t)r2[k] * x[k];
+                t3 += (int32_t)r3[k] * x[k];
+            }
+            y[i] = t0;
+            y[i + 1] = t1;
+            y[i + 2] = t2;
+            y[i + 3] = t3;
+        }
+
+        for(; i < rows; i++) {
+            const int8_t *row = w + i * cols;
+            __m256i s = _mm256_setzero_si256();
+            size_t k = 0;
+            for(; k + 16 <= cols; k += 16) {
+                __m256i xv = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(x + k)));
+                s = _mm256_add_epi32(s, _mm256_madd_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(row + k))), xv));
+            }
+            int32_t t = hsum_epi32_avx2(s);
+            for(; k < cols; k++) {
+                t += (int32_t)row[k] * x[k];
+            }
+            y[i] = t;
+        }
+        return;
+    }
+
+    __attribute__((target("avx512f,avx2")))
+    inline int32_t hsum_epi32_avx512(__m512i v) {
+        //Spill instead of shuffling, GCC 12 warns on the undefined operand of the 512 bit extracts
+        alignas(64) int32_t lanes[16];
+        _mm512_store_si512(lanes, v);
+        return hsum_epi32_avx2(_mm256_add_epi32(_mm256_load_si256((const __m256i *)lanes), _mm256_load_si256((const __m256i *)(lanes + 8))));
+    }
+
+    //Same as the AVX2 kernel with 32 int8 per step (needs AVX-512BW for the 16 bit lanes)
+    __attribute__((target("avx512f,avx512bw,avx2")))
+    inline void gemv_s8_avx512(size_t rows, size_t cols, const int8_t *w, const int8_t *x, const int32_t *rowSums, int32_t *y) {
+        size_t i = 0;
+        for(; i + 4 <= rows; i += 4) {
+            const int8_t *r0 = w + i * cols;
+            const int8_t *r1 = r0 + cols;
+            const int8_t *r2 = r1 + cols;
+            const int8_t *r3 = r2 + cols;
+            __m512i s0 = _mm512_setzero_si512();
+            __m512i s1 = _mm512_setzero_si512();
+            __m512i s2 = _mm512_setzero_si512();
+            __m512i s3 = _mm512_setzero_si512();
+
+            size_t k = 0;
+            for(; k + 32 <= cols; k += 32) {
+                __m512i xv = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(x + k)));
+                s0 = _mm512_add_epi32(s0, _mm512_madd_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(r0 + k))), xv));
+                s1 = _mm512_add_epi32(s1, _mm512_madd_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(r1 + k))), xv));
+                s2 = _mm512_add_epi32(s2, _mm512_madd_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(r2 + k))), xv));
+                s3 = _mm512_add_epi32(s3, _mm512_madd_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(r3 + k))), xv));
+            }
+            int32_t t0 = hsum_epi32_avx512(s0), t1 = hsum_epi32_avx512(s1);
+            int32_t t2 = hsum_epi32_avx512(s2), t3 = hsum_epi32_avx512(s3);
+            for(; k < cols; k++) {
+                t0 += (int32_t)r0[k] * x[k];
+                t1 += (int32_t)r1[k] * x[k];
+                t2 += (int32_t)r2[k] * x[k];
+                t3 += (int32_t)r3[k] * x[k];
+            }
+            y[i] = t0;
+            y[i + 1] = t1;
+            y[i + 2] = t2;
+            y[i + 3] = t3;
+        }
+
+        if(i < rows) {
+            gemv_s8_avx2(rows - i, cols, w + i * cols, x, rowSums, y + i);
+        }
+        return;
+    }
+
+    //64 products per instruction with no widening. x + 128 is unsigned, the offset is removed with the row sums
+    __attribute__((target("avx512f,avx512bw,avx512vnni,avx2")))
+    inline void gemv_s8_vnni(size_t rows, size_t cols, const int8_t *w, const int8_t *x, const int32_t *rowSums, int32_t *y) {
+        const __m512i flip = _mm512_set1_epi8((char)0x80);
+        size_t full = cols / 64 * 64;
+        __mmask64 tail = (cols - full) == 0 ? 0 : (~0ULL >> (64 - (cols - full)));
+        __m512i xTail = _mm512_xor_si512(_mm512_maskz_loadu_epi8(tail, x + full), flip);
+
+        size_t i = 0;
+        //4 rows at a time share every load of x
+        for(; i + 4 <= rows; i += 4) {
+            const int8_t *r0 = w + i * cols;
+            const int8_t *r1 = r0 + cols;
+            const int8_t *r2 = r1 + cols;
+            const int8_t *r3 = r2 + cols;
+            __m512i s0 = _mm512_setzero_si512();
+            __m512i s1 = _mm512_setzero_si512();
+            __m512i s2 = _mm512_setzero_si512();
+            __m512i s3 = _mm512_setzero_si512();
+
+            for(size_t k = 0; k < full; k += 64) {
+                __m512i xv = _mm512_xor_si512(_mm512_loadu_si512(x + k), flip);
+                s0 = _mm512_dpbusd_epi32(s0, xv, _mm512_loadu_si512(r0 + k));
+                s1 = _mm512_dpbusd_epi32(s1, xv, _mm512_loadu_si512(r1 + k));
+                s2 = _mm512_dpbusd_epi32(s2, xv, _mm512_loadu_si512(r2 + k));
+                s3 = _mm512_dpbusd_epi32(s3, xv, _mm512_loadu_si512(r3 + k));
+            }
+            //Masked lanes load 0 weights, so whatever the x lanes hold adds nothing
+            s0 = _mm512_dpbusd_epi32(s0, xTail, _mm512_maskz_loadu_epi8(tail, r0 + full));
+            s1 = _mm512_dpbusd_epi32(s1, xTail, _mm512_maskz_loadu_epi8(tail, r1 + full));
+            s2 = _mm512_dpbusd_epi32(s2, xTail, _mm512_maskz_loadu_epi8(tail, r2 + full));
+            s3 = _mm512_dpbusd_epi32(s3, xTail, _mm512_maskz_loadu_epi8(tail, r3 + full));
+
+            y[i] = hsum_epi32_avx512(s0) - 128 * rowSums[i];
+            y[i + 1] = hsum_epi32_avx512(s1) - 128 * rowSums[i + 1];
+            y[i + 2] = hsum_epi32_avx512(s2) - 128 * rowSums[i + 2];
+            y[i + 3] = hsum_epi32_avx512(s3) - 128 * rowSums[i + 3];
+        }
+
+        for(; i < rows; i++) {
+            const int8_t *row = w + i * cols;
+            __m512i s = _mm512_setzero_si512();
+            for(size_t k = 0; k < full; k += 64) {
+                s = _mm512_dpbusd_epi32(s, _mm512_xor_si512(_mm512_loadu_si512(x + k), flip), _mm512_loadu_si512(row + k));
+            }
+            s = _mm512_dpbusd_epi32(s, xTail, _mm512_maskz_loadu_epi8(tail, row + full));
+            y[i] = hsum_epi32_avx512(s) - 128 * rowSums[i];
+        }
+        return;
+    }
+#endif
+
+
+    /**
+     * @brief int8 kernel for an instruction set. Falls back to scalar on non x86 builds
+     *
+     * @param isa :: Instruction set (usually gemm::active_isa())
+     *
+     * @return GemvS8Kernel :: Kernel
+     */
+    inline GemvS8Kernel gemv_s8_for(gemm::ISA isa) {
+#ifdef GEMM_X86
+        static const bool hasBW = [](void) {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512bw") != 0;
+        }();
+        static const bool hasVNNI = [](void) {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512vnni") != 0;
+        }();
+        if(isa == gemm::AVX512 && hasBW && hasVNNI) {
+            return gemv_s8_vnni;
+        }
+        if(isa == gemm::AVX512 && hasBW) {
+            return gemv_s8_avx512;
+        }
+        if(isa >= gemm::AVX2) {
+            return gemv_s8_avx2;
+        }
+#endif
+        (void)isa;
+        return gemv_s8_scalar;
+    }
+
+
+    /**
+     * @brief Dequantize int32 accumulators, add the bias and apply an activation
+     *
+     * @param act :: Activation function
+     * @param acc :: rows accumulators
+     * @param wScale :: Per row weight scales
+     * @param xScale :: Scale of the quantized input
+     * @param bias :: rows biases
+     * @param out :: Output, one value every stride floats
+     * @param stride :: Distance between outputs (batch size)
+     * @param rows :: Number of outputs
+     *
+     * @return void :: None
+     */
+    inline void dequantize_activate(perceptron::ACTIVATION_FUNCTION act, const int32_t *acc, const float *wScale, float xScale,
+                                    const float *bias, float *out, size_t stride, size_t rows) {
+        switch(act) {
+            case perceptron::RELU: {
+                for(size_t i = 0; i < rows; i++) {
+                    float v = (float)acc[i] * (wScale[i] * xScale) + bias[i];
+                    out[i * stride] = (v > 0) * v;
+                }
+                break;
+            }
+            case perceptron::SIGMOID: {
+                for(size_t i = 0; i < rows; i++) {
+                    float v = (float)acc[i] * (wScale[i] * xScale) + bias[i];
+                    out[i * stride] = 1/(1 + exp(-1 * v));
+                }
+                break;
+            }
+            case perceptron::TANH: {
+                for(size_t i = 0; i < rows; i++) {
+                    out[i * stride] = tanh((float)acc[i] * (wScale[i] * xScale) + bias[i]);
+                }
+                break;
+            }
+        }
+        return;
+    }
+}
+
+
+namespace perceptron {
+
+    class QuantizedModel;
+
+    class QuantizedWorkspace {
+        private:
+        std::vector<float> buffers[2]; //Layer outputs, widest layer x batch
+        std::vector<int8_t> quantized; //Layer input, one quantized sample after the other
+        std::vector<float> scales; //Scale of every quantized sample
+        std::vector<int32_t> accumulators; //Current sample's layer output
+
+        friend class QuantizedModel;
+
+        public:
+        QuantizedWorkspace(void) {}
+
+        /**
+         * @brief Allocate a workspace for a model up front
+         *
+         * @param model :: Model the workspace will be used with
+         * @param maxBatch :: Largest batch expected (larger batches still work, they grow the buffers)
+         */
+        QuantizedWorkspace(const QuantizedModel &model, size_t maxBatch = 1);
+
+        /**
+         * @brief Make sure the buffers fit a batch. Never shrinks, so a warm workspace does not allocate
+         *
+         * @param model :: Model the workspace is used with
+         * @param batchSize :: Samples per forward pass
+         *
+         * @return void :: None
+         */
+        void reserve(const QuantizedModel &model, size_t batchSize);
+
+        /**
+         * @brief Memory held by the workspace
+         *
+         * @return size_t :: Bytes of buffers
+         */
+        size_t bytes(void) const {
+            return (this->buffers[0].capacity() + this->buffers[1].capacity()) * sizeof(float) +
+                   this->quantized.capacity() + this->scales.capacity() * sizeof(float) +
+                   this->accumulators.capacity() * sizeof(int32_t);
+        }
+    };
+
+
+    class QuantizedModel {
+        private:
+        typedef struct Storage {
+            std::vector<int8_t> w;
+            std::vector<float> scale;
+            std::vector<float> b;
+        } Storage;
+
+        //Exactly one of these owns the memory the views point into. Copies of the model share it
+        std::shared_ptr<const Storage> storage;
+        std::shared_ptr<const modelfile::MappedModel> mapping;
+        std::vector<modelfile::QuantizedLayerView> layers;
+        std::vector<std::vector<int32_t>> rowSums; //Sum of every weight row, per layer
+        size_t widestIn;
+        size_t widestOut;
+
+
+        /**
+         * @brief Check the layers can be run (known activations), record the widest layers and sum the weight rows
+         *
+         * @return bool :: true if the model is usable
+         */
+        bool validate(void) {
+            this->widestIn = 0;
+            this->widestOut = 0;
+            this->rowSums.clear();
+            for(const modelfile::QuantizedLayerView &view : this->layers) {
+                if(view.act > TANH) {
+                    return false;
+                }
+                this->widestIn = std::max(this->widestIn, view.cols);
+                this->widestOut = std::max(this->widestOut, view.rows);
+
+                std::vector<int32_t> sums(view.rows, 0);
+                for(size_t i = 0; i < view.rows; i++) {
+                    for(size_t k = 0; k < view.cols; k++) {
+                        sums[i] += view.w[i * view.cols + k];
+                    }
+                }
+                this->rowSums.push_back(sums);
+            }
+            return !this->layers.empty();
+        }
+
+        public:
+        QuantizedModel(void) {
+            this->widestIn = 0;
+            this->widestOut = 0;
+        }
+
+        /**
+         * @brief Quantize the weights of a trained network (biases stay float)
+         *
+         * @param net :: Network to quantize
+         */
+        QuantizedModel(Perceptron &net) {
+            std::shared_ptr<Storage> owned = std::make_shared<Storage>();
+            size_t weights = 0;
+            size_t rows = 0;
+            for(Layer &layer : net.layers) {
+                weights += layer.w.get_vector().size();
+                rows += layer.w.get_rows();
+            }
+            owned->w.resize(weights);
+            owned->scale.resize(rows);
+            owned->b.resize(rows);
+
+            weights = 0;
+            rows = 0;
+            for(Layer &layer : net.layers) {
+                modelfile::QuantizedLayerView view;
+                view.rows = layer.w.get_rows();
+                view.cols = layer.w.get_cols();
+                view.act = layer.act;
+
+                const float *w = layer.w.get_vector().data();
+                for(size_t i = 0; i < view.rows; i++) {
+                    owned->scale[rows + i] = quant::quantize(w + i * view.cols, view.cols, owned->w.data() + weights + i * view.cols);
+                }
+                std::copy(layer.b.get_vector().begin(), layer.b.get_vector().end(), owned->b.begin() + rows);
+
+                view.w = owned->w.data() + weights;
+                view.scale = owned->scale.data() + rows;
+                view.b = owned->b.data() + rows;
+                this->layers.push_back(view);
+
+                weights += view.rows * view.cols;
+                rows += view.rows;
+            }
+            this->storage = owned;
+            this->validate();
+        }
+
+
+        /**
+         * @brief Map an int8 model written by save_file. Weights are used in place, not copied
+         *
+         * @param fileName :: Binary int8 model file
+         *
+         * @return bool :: Indication of if the model was mapped (the model is left empty on failure)
+         */
+        bool open(const std::string &fileName) {
+            this->storage.reset();
+            this->mapping.reset();
+            this->layers.clear();
+            this->rowSums.clear();
+
+            std::shared_ptr<modelfile::MappedModel> model = std::make_shared<modelfile::MappedModel>();
+            if(!model->open(fileName)) {
+                return false;
+            }
+
+            this->layers = model->get_quantized_layers();
+            if(!this->validate()) {
+                this->layers.clear();
+                this->rowSums.clear();
+                return false;
+            }
+            this->mapping = model;
+            return true;
+        }
+
+        /**
+         * @brief Save the model as an int8 binary model file. See model_file.h++ for the layout
+         *
+         * @param fileName :: File name to save the model to
+         *
+         * @return bool :: Indication of if save was successful
+         */
+        bool save_file(std::string fileName) const {
+            if(this->layers.empty()) {
+                return false;
+            }
+            return modelfile::write_int8(fileName, this->layers);
+        }
+
+
+        /**
+         * @brief Whether the model holds any layers
+         *
+         * @return bool :: true if nothing is loaded
+         */
+        bool empty(void) const {
+            return this->layers.empty();
+        }
+
+        size_t input_size(void) const {
+            return this->layers.empty() ? 0 : this->layers.front().cols;
+        }
+
+        size_t output_size(void) const {
+            return this->layers.empty() ? 0 : this->layers.back().rows;
+        }
+
+        size_t widest_input(void) const {
+            return this->widestIn;
+        }
+
+        size_t widest_layer(void) const {
+            return this->widestOut;
+        }
+
+        /**
+         * @brief Memory used by the int8 weights, scales and biases (shared by every copy of the model)
+         *
+         * @return size_t :: Bytes of parameters
+         */
+        size_t weight_bytes(void) const {
+            size_t bytes = 0;
+            for(const modelfile::QuantizedLayerView &view : this->layers) {
+                bytes += view.rows * view.cols + 2 * view.rows * sizeof(float);
+            }
+            return bytes;
+        }
+
+
+        /**
+         * @brief Forward pass on a batch. Safe to call from many threads at once with different workspaces
+         *
+         * The batch is quantized in one pass, then samples run one at a time through the int8 kernels
+         * (the int8 weights are small enough to stay in cache between samples)
+         *
+         * @param x :: Inputs, one sample per column (inputs x batch size, row major)
+         * @param batchSize :: Number of samples
+         * @param ws :: Caller's workspace, grown if it is too small
+         *
+         * @return const float* :: Outputs inside ws (outputs x batch size, row major), valid until ws is used again
+         */
+        const float *forward(const float *x, size_t batchSize, QuantizedWorkspace &ws) const {
+            if(this->layers.empty()) {
+                throw std::logic_error("No model loaded\n");
+            }
+            ws.reserve(*this, batchSize);
+            quant::GemvS8Kernel kernel = quant::gemv_s8_for(gemm::active_isa());
+
+            const float *in = x;
+            for(size_t i = 0; i < this->layers.size(); i++) {
+                const modelfile::QuantizedLayerView &view = this->layers[i];
+                float *out = ws.buffers[i % 2].data();
+
+                quant::quantize_columns(in, view.cols, batchSize, ws.quantized.data(), ws.scales.data());
+                for(size_t j = 0; j < batchSize; j++) {
+                    kernel(view.rows, view.cols, view.w, ws.quantized.data() + j * view.cols, this->rowSums[i].data(),
+                           ws.accumulators.data());
+                    quant::dequantize_activate((ACTIVATION_FUNCTION)view.act, ws.accumulators.data(), view.scale, ws.scales[j],
+                                               view.b, out + j, batchSize, view.rows);
+                }
+                in = out;
+            }
+            return in;
+        }
+
+        /**
+         * @brief Forward pass on a single sample
+         *
+         * @param x :: Input vector
+         * @param ws :: Caller's workspace
+         *
+         * @return const float* :: output_size() values inside ws, valid until ws is used again
+         */
+        const float *forward(const std::vector<float> &x, QuantizedWorkspace &ws) const {
+            if(x.size() != this->input_size()) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+            return this->forward(x.data(), 1, ws);
+        }
+
+        /**
+         * @brief Run forward pass and return predicted class index
+         *
+         * @param x :: Input vector
+         * @param ws :: Caller's workspace
+         *
+         * @return int :: Index of highest output value
+         */
+        int predict_class(const std::vector<float> &x, QuantizedWorkspace &ws) const {
+            const float *out = this->forward(x, ws);
+            int best = 0;
+            for(size_t i = 1; i < this->output_size(); i++) {
+                if(out[i] > out[best]) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+    };
+
+
+    inline QuantizedWorkspace::QuantizedWorkspace(const QuantizedModel &model, size_t maxBatch) {
+        this->reserve(model, maxBatch);
+    }
+
+    inline void QuantizedWorkspace::reserve(const QuantizedModel &model, size_t batchSize) {
+        size_t needed = model.widest_layer() * batchSize;
+        if(this->buffers[0].size() < needed) {
+            this->buffers[0].resize(needed);
+            this->buffers[1].resize(needed);
+        }
+        if(this->quantized.size() < model.widest_input() * batchSize) {
+            this->quantized.resize(model.widest_input() * batchSize);
+        }
+        if(this->scales.size() < batchSize) {
+            this->scales.resize(batchSize);
+        }
+        if(this->accumulators.size() < model.widest_layer()) {
+            this->accumulators.resize(model.widest_layer());
+        }
+        return;
+    }
+}
+
+
+
+#endif
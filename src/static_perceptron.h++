@@ -0,0 +1,483 @@
+#ifndef STATIC_PERCEPTRON_H
+#define STATIC_PERCEPTRON_H
+#include <array>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include "./perceptron.h++"
+
+
+/**
+ * NOTE: Fixed topology networks
+ * StaticPerceptron<Topology<2, 4, 1>, Activations<TANH, SIGMOID>> is a Perceptron whose shape is part of its type.
+ * Weights live in std::array members (no heap, no rows/cols lookups), the activation of each layer is a template
+ * argument (no switch per call) and layers of up to STATIC_UNROLL_LIMIT inputs/outputs are fully unrolled
+ *
+ * Meant for XOR/IRIS sized models evaluated millions of times a second. Large layers still work, but
+ * Perceptron with its blocked gemm kernels is the better fit there
+ *
+ * save_file/read_file use the same binary format as Perceptron, so models move freely between the two
+ */
+
+
+//Loops over at most this many iterations are unrolled at compile time
+#ifndef STATIC_UNROLL_LIMIT
+#define STATIC_UNROLL_LIMIT 32
+#endif
+
+
+namespace perceptron {
+
+    template <size_t... Sizes>
+    struct Topology {};
+
+    template <ACTIVATION_FUNCTION... Acts>
+    struct Activations {};
+}
+
+
+namespace fixed {
+
+    using perceptron::ACTIVATION_FUNCTION;
+
+
+    template <size_t N, typename F, size_t... I>
+    inline void unroll_impl(F &&f, std::index_sequence<I...>) {
+        (f(std::integral_constant<size_t, I>()), ...);
+    }
+
+    /**
+     * @brief Call f(i) for i = 0..N-1. Unrolled at compile time when N <= STATIC_UNROLL_LIMIT, a plain loop otherwise
+     *
+     * @param f :: Callable taking the index
+     *
+     * @return void :: None
+     */
+    template <size_t N, typename F>
+    inline void repeat(F &&f) {
+        if constexpr (N <= STATIC_UNROLL_LIMIT) {
+            unroll_impl<N>(f, std::make_index_sequence<N>());
+        } else {
+            for(size_t i = 0; i < N; i++) {
+                f(i);
+            }
+        }
+    }
+
+
+    template <ACTIVATION_FUNCTION Act>
+    inline float activate(float v) {
+        if constexpr (Act == perceptron::RELU) {
+            return (v > 0) * v;
+        } else if constexpr (Act == perceptron::SIGMOID) {
+            return 1/(1 + exp(-1 * v));
+        } else {
+            return tanh(v);
+        }
+    }
+
+    //G'(a), written in terms of the activated output
+    template <ACTIVATION_FUNCTION Act>
+    inline float derivative(float a) {
+        if constexpr (Act == perceptron::RELU) {
+            return (float)(a > 0);
+        } else if constexpr (Act == perceptron::SIGMOID) {
+            return a * (1 - a);
+        } else {
+            return 1 - (a * a);
+        }
+    }
+
+
+    /**
+     * @brief One layer of a fixed topology network. Weights are row major (Out x In) like Perceptron
+     */
+    template <size_t In, size_t Out, ACTIVATION_FUNCTION Act>
+    struct Layer {
+        static constexpr size_t inputs = In;
+        static constexpr size_t outputs = Out;
+        static constexpr ACTIVATION_FUNCTION act = Act;
+
+        alignas(64) std::array<float, Out * In> w; //Weights
+        std::array<float, Out> b; //Biases
+        std::array<float, Out> a; //Activated output
+        std::array<float, Out> dZ;
+    };
+
+
+    //Pairs neighbouring sizes with their activation: Topology<2, 4, 1>, Activations<A, B> -> tuple<Layer<2, 4, A>, Layer<4, 1, B>>
+    template <typename Topo, typename Acts>
+    struct Chain {
+        using type = std::tuple<>;
+    };
+
+    template <size_t In, size_t Out, size_t... Rest, ACTIVATION_FUNCTION Act, ACTIVATION_FUNCTION... RestActs>
+    struct Chain<perceptron::Topology<In, Out, Rest...>, perceptron::Activations<Act, RestActs...>> {
+        using type = decltype(std::tuple_cat(
+            std::declval<std::tuple<Layer<In, Out, Act>>>(),
+            std::declval<typename Chain<perceptron::Topology<Out, Rest...>, perceptron::Activations<RestActs...>>::type>()));
+    };
+
+
+    /**
+     * @brief out = G(W * x + b)
+     *
+     * @param w :: Out x In weights
+     * @param b :: Out biases
+     * @param x :: In inputs
+     * @param out :: Receives Out outputs
+     *
+     * @return void :: None
+     */
+    template <size_t In, size_t Out, ACTIVATION_FUNCTION Act>
+    inline void dense(const float *w, const float *b, const float *x, float *out) {
+        repeat<Out>([&](size_t o) {
+            const float *row = w + o * In;
+            float sum = 0;
+            repeat<In>([&](size_t k) {
+                sum += row[k] * x[k];
+            });
+            out[o] = activate<Act>(sum + b[o]);
+        });
+    }
+
+
+    /**
+     * @brief dZPrev = Hadamard(W^T * dZ, G'(aPrev))
+     *
+     * @param w :: Out x In weights of the layer above
+     * @param dZ :: Out gradients of the layer above
+     * @param aPrev :: In activated outputs of the layer below
+     * @param dZPrev :: Receives In gradients
+     *
+     * @return void :: None
+     */
+    template <size_t In, size_t Out, ACTIVATION_FUNCTION ActPrev>
+    inline void delta(const float *w, const float *dZ, const float *aPrev, float *dZPrev) {
+        repeat<In>([&](size_t k) {
+            float sum = 0;
+            repeat<Out>([&](size_t o) {
+                sum += w[o * In + k] * dZ[o];
+            });
+            dZPrev[k] = sum * derivative<ActPrev>(aPrev[k]);
+        });
+    }
+
+
+    /**
+     * @brief W -= lr * dZ * aPrev^T, b -= lr * dZ
+     *
+     * @param w :: Out x In weights
+     * @param b :: Out biases
+     * @param dZ :: Out gradients
+     * @param aPrev :: In inputs to the layer
+     * @param lr :: Learning rate
+     *
+     * @return void :: None
+     */
+    template <size_t In, size_t Out>
+    inline void update(float *w, float *b, const float *dZ, const float *aPrev, float lr) {
+        repeat<Out>([&](size_t o) {
+            float step = -lr * dZ[o];
+            float *row = w + o * In;
+            repeat<In>([&](size_t k) {
+                row[k] += step * aPrev[k];
+            });
+            b[o] += step;
+        });
+    }
+}
+
+
+namespace perceptron {
+
+    template <typename Topo, typename Acts>
+    class StaticPerceptron;
+
+
+    template <size_t... Sizes, ACTIVATION_FUNCTION... Acts>
+    class StaticPerceptron<Topology<Sizes...>, Activations<Acts...>> {
+        static_assert(sizeof...(Sizes) >= 2, "A network needs at least an input and an output size");
+        static_assert(sizeof...(Sizes) == sizeof...(Acts) + 1, "Need one activation per layer (one less than the sizes)");
+
+        public:
+        static constexpr size_t LAYERS = sizeof...(Acts);
+        static constexpr std::array<size_t, sizeof...(Sizes)> SIZES = {Sizes...};
+        static constexpr size_t INPUTS = SIZES.front();
+        static constexpr size_t OUTPUTS = SIZES.back();
+
+        typedef std::array<float, INPUTS> Input;
+        typedef std::array<float, OUTPUTS> Output;
+
+        private:
+        Input input; //Copy of the last forward input, read by backward
+        typename fixed::Chain<Topology<Sizes...>, Activations<Acts...>>::type layers;
+
+
+        template <size_t I>
+        const float *forward_from(const float *x) {
+            auto &layer = std::get<I>(this->layers);
+            using L = std::remove_reference_t<decltype(layer)>;
+
+            fixed::dense<L::inputs, L::outputs, L::act>(layer.w.data(), layer.b.data(), x, layer.a.data());
+
+            if constexpr (I + 1 < LAYERS) {
+                return this->forward_from<I + 1>(layer.a.data());
+            } else {
+                return layer.a.data();
+            }
+        }
+
+
+        //dZ of layer I is known. Find dZ of layer I - 1 from the old weights, then update layer I
+        template <size_t I>
+        void backward_from(float lr) {
+            auto &layer = std::get<I>(this->layers);
+            using L = std::remove_reference_t<decltype(layer)>;
+
+            if constexpr (I > 0) {
+                auto &prev = std::get<I - 1>(this->layers);
+                using P = std::remove_reference_t<decltype(prev)>;
+
+                fixed::delta<L::inputs, L::outputs, P::act>(layer.w.data(), layer.dZ.data(), prev.a.data(), prev.dZ.data());
+                fixed::update<L::inputs, L::outputs>(layer.w.data(), layer.b.data(), layer.dZ.data(), prev.a.data(), lr);
+                this->backward_from<I - 1>(lr);
+            } else {
+                fixed::update<L::inputs, L::outputs>(layer.w.data(), layer.b.data(), layer.dZ.data(), this->input.data(), lr);
+            }
+        }
+
+
+        //Collect views of every layer, in order
+        template <size_t... I>
+        std::vector<modelfile::LayerView> views(std::index_sequence<I...>) {
+            std::vector<modelfile::LayerView> out;
+            (out.push_back({std::get<I>(this->layers).outputs, std::get<I>(this->layers).inputs, (uint32_t)std::get<I>(this->layers).act,
+                            std::get<I>(this->layers).w.data(), std::get<I>(this->layers).b.data()}), ...);
+            return out;
+        }
+
+
+        //Every stored layer has the shape and activation of this topology
+        template <size_t I>
+        bool matches(const std::vector<modelfile::LayerView> &views) {
+            if constexpr (I == LAYERS) {
+                return true;
+            } else {
+                using L = std::tuple_element_t<I, decltype(this->layers)>;
+                const modelfile::LayerView &view = views[I];
+                if(view.rows != L::outputs || view.cols != L::inputs || view.act != (uint32_t)L::act) {
+                    return false;
+                }
+                return this->matches<I + 1>(views);
+            }
+        }
+
+
+        template <size_t... I>
+        void copy_layers(const std::vector<modelfile::LayerView> &views, std::index_sequence<I...>) {
+            ((std::copy(views[I].w, views[I].w + std::get<I>(this->layers).w.size(), std::get<I>(this->layers).w.begin()),
+              std::copy(views[I].b, views[I].b + std::get<I>(this->layers).b.size(), std::get<I>(this->layers).b.begin())), ...);
+        }
+
+
+        //Same scheme as Perceptron: He for ReLU layers, Xavier for sigmoid/tanh layers
+        template <size_t... I>
+        void randomise(std::mt19937 &rng, std::index_sequence<I...>) {
+            (randomise_layer(std::get<I>(this->layers), rng), ...);
+        }
+
+        template <typename L>
+        static void randomise_layer(L &layer, std::mt19937 &rng) {
+            if constexpr (L::act == RELU) {
+                std::normal_distribution<float> dist(0, std::sqrt(((float)2)/L::inputs));
+                for(float &v : layer.w) {
+                    v = dist(rng);
+                }
+            } else {
+                float d = sqrt((float)(6)/((float)L::inputs + (float)L::outputs));
+                std::uniform_real_distribution<float> dist(-d, d);
+                for(float &v : layer.w) {
+                    v = dist(rng);
+                }
+            }
+            layer.b.fill(0.0f);
+            layer.a.fill(0.0f);
+            layer.dZ.fill(0.0f);
+        }
+
+
+        public:
+        /**
+         * @brief Construct a network with randomised weights and zero biases
+         */
+        StaticPerceptron() {
+            std::mt19937 rng(std::random_device{}());
+            this->input.fill(0.0f);
+            this->randomise(rng, std::make_index_sequence<LAYERS>());
+        }
+
+
+        /**
+         * @brief Forward pass on a single sample
+         *
+         * @param x :: INPUTS values
+         *
+         * @return const Output & :: Output of the network, valid until the next forward
+         */
+        const Output &forward(const float *x) {
+            std::copy(x, x + INPUTS, this->input.begin());
+            this->forward_from<0>(this->input.data());
+            return std::get<LAYERS - 1>(this->layers).a;
+        }
+
+        const Output &forward(const Input &x) {
+            return this->forward(x.data());
+        }
+
+
+        /**
+         * @brief Mean squared error of the last forward pass
+         *
+         * @param y :: Expected output
+         *
+         * @return float :: MSE
+         */
+        float mse(const Output &y) {
+            const Output &out = std::get<LAYERS - 1>(this->layers).a;
+            float mse = 0;
+            for(size_t i = 0; i < OUTPUTS; i++) {
+                float diff = y[i] - out[i];
+                mse += diff * diff;
+            }
+            return mse / (float)OUTPUTS;
+        }
+
+
+        /**
+         * @brief Backpropagation and SGD step on the last forward pass, same math as Perceptron::backward
+         *
+         * @param y :: Expected output
+         * @param lr :: Learning rate
+         *
+         * @return void :: None
+         */
+        void backward(const Output &y, float lr) {
+            auto &last = std::get<LAYERS - 1>(this->layers);
+            using L = std::remove_reference_t<decltype(last)>;
+
+            //dZ = Hadamard(A - y, G'(A))
+            fixed::repeat<OUTPUTS>([&](size_t o) {
+                last.dZ[o] = (last.a[o] - y[o]) * fixed::derivative<L::act>(last.a[o]);
+            });
+            this->backward_from<LAYERS - 1>(lr);
+        }
+
+
+        /**
+         * @brief Shuffled single sample SGD
+         *
+         * @param inputs :: Input samples
+         * @param targets :: Target for each sample (same order as inputs)
+         * @param epochs :: Passes over the data
+         * @param lr :: Learning rate
+         * @param verbose :: Print the loss every 100 epochs
+         *
+         * @return void :: None
+         */
+        void train(const std::vector<Input> &inputs, const std::vector<Output> &targets, int epochs, float lr, bool verbose = true) {
+            if(inputs.size() != targets.size()) {
+                throw std::invalid_argument("Incompatable input and target vector dimensions\n");
+            }
+            if(inputs.empty()) {
+                return;
+            }
+
+            std::vector<size_t> order(inputs.size());
+            for(size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::mt19937 rng(std::random_device{}());
+
+            for(int epoch = 0; epoch < epochs; epoch++) {
+                float totalLoss = 0.0f;
+                std::shuffle(order.begin(), order.end(), rng);
+
+                for(size_t idx : order) {
+                    this->forward(inputs[idx]);
+                    totalLoss += this->mse(targets[idx]);
+                    this->backward(targets[idx], lr);
+                }
+
+                totalLoss /= inputs.size();
+
+                if(verbose && (epoch % 100 == 0 || epoch == epochs-1)) {
+                    std::cout << "Epoch " << epoch << " | Loss: " << totalLoss << "\n";
+                }
+            }
+        }
+
+
+        /**
+         * @brief Index of the largest output
+         *
+         * @param x :: Input sample
+         *
+         * @return int :: Predicted class
+         */
+        int predict_class(const Input &x) {
+            const Output &out = this->forward(x);
+            return (int)(std::max_element(out.begin(), out.end()) - out.begin());
+        }
+
+
+        /**
+         * @brief Save the weights in the Perceptron binary format
+         *
+         * @param fileName :: File to write
+         *
+         * @return bool :: true if the file was written
+         */
+        bool save_file(std::string fileName) {
+            return modelfile::write(fileName, this->views(std::make_index_sequence<LAYERS>()));
+        }
+
+
+        /**
+         * @brief Load weights saved by Perceptron::save_file or StaticPerceptron::save_file
+         *
+         * The file must have exactly this topology and these activations, otherwise nothing is changed.
+         * Text model files are not read, migrate them with Perceptron::read_file then save_file
+         *
+         * @param fileName :: File to read
+         *
+         * @return bool :: true if the weights were loaded
+         */
+        bool read_file(std::string fileName) {
+            modelfile::MappedModel model;
+            if(!model.open(fileName) || model.get_layers().size() != LAYERS) {
+                return false;
+            }
+            if(!this->matches<0>(model.get_layers())) {
+                return false;
+            }
+
+            this->copy_layers(model.get_layers(), std::make_index_sequence<LAYERS>());
+            return true;
+        }
+
+
+        /**
+         * @brief Bytes of the network object (weights, biases and buffers, there is no heap storage)
+         *
+         * @return size_t :: sizeof the network
+         */
+        static constexpr size_t bytes(void) {
+            return sizeof(StaticPerceptron);
+        }
+    };
+}
+
+
+
+#endif
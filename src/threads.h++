@@ -0,0 +1,166 @@
+#ifndef THREADS_H
+#define THREADS_H
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <vector>
+
+
+/**
+ * NOTE: Persistent worker pool used for data parallel training
+ * Threads are created once and parked on a condition variable between jobs,
+ * so a training step only pays for a wake up, not a thread creation
+ */
+
+
+namespace threads {
+    class ThreadPool {
+        private:
+        std::vector<std::thread> workers;
+
+        std::mutex lock;
+        std::condition_variable wake; //Signalled when a new job is posted
+        std::condition_variable done; //Signalled when the last worker finishes
+
+        std::function<void(size_t)> job;
+        size_t generation; //Incremented for every job, workers compare against the last one they ran
+        size_t pending; //Workers still running the current job
+        bool stopping;
+        std::exception_ptr error; //First exception thrown by a worker
+
+
+        /**
+         * @brief Loop run by every spawned worker
+         *
+         * @param id :: Worker index (1 to size - 1, the caller of run is worker 0)
+         *
+         * @return void :: None
+         */
+        void worker_loop(size_t id) {
+            size_t seen = 0;
+            while(1) {
+                std::function<void(size_t)> current;
+                {
+                    std::unique_lock<std::mutex> guard(this->lock);
+                    this->wake.wait(guard, [&](void) {
+                        return this->stopping || this->generation != seen;
+                    });
+                    if(this->stopping) {
+                        return;
+                    }
+                    seen = this->generation;
+                    current = this->job;
+                }
+
+                try {
+                    current(id);
+                } catch(...) {
+                    std::lock_guard<std::mutex> guard(this->lock);
+                    if(!this->error) {
+                        this->error = std::current_exception();
+                    }
+                }
+
+                std::lock_guard<std::mutex> guard(this->lock);
+                if(--this->pending == 0) {
+                    this->done.notify_all();
+                }
+            }
+        }
+
+        public:
+        /**
+         * @brief Start a pool. The calling thread counts as one of the threads
+         *
+         * @param threads :: Total threads taking part in each job (0 uses the hardware thread count)
+         */
+        ThreadPool(size_t threads) {
+            if(threads == 0) {
+                threads = std::thread::hardware_concurrency();
+            }
+            if(threads == 0) {
+                threads = 1;
+            }
+
+            this->generation = 0;
+            this->pending = 0;
+            this->stopping = false;
+
+            this->workers.reserve(threads - 1);
+            for(size_t i = 1; i < threads; i++) {
+                this->workers.emplace_back(&ThreadPool::worker_loop, this, i);
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->wake.notify_all();
+            for(std::thread &worker : this->workers) {
+                worker.join();
+            }
+        }
+
+
+        /**
+         * @brief Number of threads taking part in each job
+         *
+         * @return size_t :: Thread count (including the caller)
+         */
+        size_t size(void) {
+            return this->workers.size() + 1;
+        }
+
+
+        /**
+         * @brief Run fn(id) once on every thread (id 0 to size - 1) and wait for all of them
+         *
+         * The calling thread runs id 0. Rethrows the first exception thrown by any thread
+         *
+         * @param fn :: Job to run
+         *
+         * @return void :: None
+         */
+        void run(const std::function<void(size_t)> &fn) {
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                this->job = fn;
+                this->pending = this->workers.size();
+                this->error = nullptr;
+                this->generation++;
+            }
+            this->wake.notify_all();
+
+            std::exception_ptr callerError = nullptr;
+            try {
+                fn(0);
+            } catch(...) {
+                callerError = std::current_exception();
+            }
+
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->done.wait(guard, [&](void) {
+                return this->pending == 0;
+            });
+
+            if(callerError) {
+                std::rethrow_exception(callerError);
+            }
+            if(this->error) {
+                std::rethrow_exception(this->error);
+            }
+            return;
+        }
+    };
+}
+
+
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+#include <functional>
+#include "./perceptron.h++"
+#include "./threads.h++"
+
+
+/**
+ * NOTE: Data parallel training on top of Perceptron
+ * Every thread owns a replica of the activation and gradient buffers and reads the shared weights
+ *
+ * SYNCHRONOUS: each mini-batch is split into one shard per thread. Shard gradients are summed with a
+ * pairwise tree (fixed order, so a given thread count always gives the same result) then applied once
+ *
+ * HOGWILD: each thread walks its own slice of the epoch and applies its gradients straight to the shared
+ * weights without locking. Threads may read weights while another thread writes them. This is the
+ * intended trade (no synchronisation, slightly stale reads), but results are not reproducible
+ */
+
+
+namespace perceptron {
+
+    typedef enum PARALLEL_MODE {
+        SYNCHRONOUS,
+        HOGWILD,
+    } PARALLEL_MODE;
+
+    class ParallelTrainer {
+        private:
+        Perceptron &net;
+        threads::ThreadPool pool;
+
+        //Per thread buffers, indexed by worker id
+        std::vector<std::vector<Layer>> replicas;
+        std::vector<matrix::Matrix<float>> shardX;
+        std::vector<matrix::Matrix<float>> shardY;
+        std::vector<float> shardLoss; //Summed (not averaged) loss of each shard
+
+
+        /**
+         * @brief Copy a run of columns out of a batch matrix
+         *
+         * @param src :: Source batch
+         * @param start :: First column
+         * @param n :: Number of columns
+         * @param dst :: Destination, resized to src rows x n
+         *
+         * @return void :: None
+         */
+        static void copy_columns(matrix::Matrix<float> &src, size_t start, size_t n, matrix::Matrix<float> &dst) {
+            dst.resize(src.get_rows(), n);
+            for(size_t i = 0; i < src.get_rows(); i++) {
+                for(size_t j = 0; j < n; j++) {
+                    dst.at(i, j) = src.at(i, start + j);
+                }
+            }
+            return;
+        }
+
+
+        /**
+         * @brief Forward and backward on the shard currently held by a worker
+         *
+         * @param t :: Worker id
+         *
+         * @return void :: None
+         */
+        void run_shard(size_t t) {
+            size_t n = this->shardX[t].get_cols();
+            Perceptron::resize_state(this->replicas[t], n);
+
+            this->net.forward_layers(this->shardX[t], this->replicas[t]);
+            this->shardLoss[t] += Perceptron::mean_squared_error(this->replicas[t].back().a, this->shardY[t]) * n;
+            this->net.backward_layers(this->shardX[t], this->shardY[t], this->replicas[t]);
+            return;
+        }
+
+
+        /**
+         * @brief One synchronous step. Splits a batch into contiguous shards, one per worker
+         *
+         * @param total :: Samples in the batch
+         * @param lr :: Learning rate
+         * @param fill :: Called on each worker as fill(t, start, n) to load its shard into shardX[t]/shardY[t]
+         *
+         * @return float :: Summed loss over the batch
+         */
+        float step_shards(size_t total, float lr, const std::function<void(size_t, size_t, size_t)> &fill) {
+            size_t workers = this->pool.size();
+            size_t active = std::min(workers, total);
+            size_t base = total / workers;
+            size_t extra = total % workers;
+
+            this->pool.run([&](size_t t) {
+                this->shardLoss[t] = 0;
+                if(t >= active) {
+                    return;
+                }
+                size_t start = t * base + std::min(t, extra);
+                size_t n = base + (t < extra);
+                fill(t, start, n);
+                this->run_shard(t);
+            });
+
+            //Pairwise tree, replica t absorbs replica t + stride
+            for(size_t stride = 1; stride < active; stride *= 2) {
+                this->pool.run([&](size_t t) {
+                    if(t % (2 * stride) != 0 || t + stride >= active) {
+                        return;
+                    }
+                    for(size_t l = 0; l < this->replicas[t].size(); l++) {
+                        this->replicas[t][l].dw.add(this->replicas[t + stride][l].dw);
+                        this->replicas[t][l].db.add(this->replicas[t + stride][l].db);
+                    }
+                });
+            }
+
+            this->net.apply_gradients(this->replicas[0], lr / (float)total);
+
+            float loss = 0;
+            for(size_t t = 0; t < active; t++) {
+                loss += this->shardLoss[t];
+            }
+            return loss;
+        }
+
+        public:
+        /**
+         * @brief Attach a trainer and its worker pool to a network
+         *
+         * The network must outlive the trainer, and must not be reloaded (read_file) while the trainer exists
+         *
+         * @param net :: Network to train
+         * @param threadCount :: Worker threads (0 uses the hardware thread count)
+         */
+        ParallelTrainer(Perceptron &net, size_t threadCount = 0) : net(net), pool(threadCount) {
+            size_t nIn = net.input.get_rows();
+            size_t nOut = net.layers.back().w.get_rows();
+
+            for(size_t t = 0; t < this->pool.size(); t++) {
+                this->replicas.push_back(net.make_replica(1));
+                this->shardX.emplace_back(nIn, 1);
+                this->shardY.emplace_back(nOut, 1);
+            }
+            this->shardLoss.resize(this->pool.size());
+        }
+
+
+        /**
+         * @brief Number of threads used for training
+         *
+         * @return size_t :: Thread count
+         */
+        size_t thread_count(void) {
+            return this->pool.size();
+        }
+
+
+        /**
+         * @brief One synchronous gradient step on a mini-batch, split across every thread
+         *
+         * Same update as Perceptron::forward_batch + backward_batch, up to float rounding
+         *
+         * @param x :: Input batch (inputs x batch size)
+         * @param y :: Expected output (outputs x batch size)
+         * @param lr :: Learning rate
+         *
+         * @return float :: MSE of the batch before the update
+         */
+        float step(matrix::Matrix<float> &x, matrix::Matrix<float> &y, float lr) {
+            if(x.get_rows() != this->shardX[0].get_rows() || x.get_cols() == 0) {
+                throw std::invalid_argument("Network was passed incompatable x dimension\n");
+            }
+            if(y.get_rows() != this->shardY[0].get_rows() || y.get_cols() != x.get_cols()) {
+                throw std::invalid_argument("Network was passed incompatable y dimension\n");
+            }
+
+            float loss = this->step_shards(x.get_cols(), lr, [&](size_t t, size_t start, size_t n) {
+                copy_columns(x, start, n, this->shardX[t]);
+                copy_columns(y, start, n, this->shardY[t]);
+            });
+            return loss / (float)x.get_cols();
+        }
+
+
+        /**
+         * @brief Train on multiple samples for multiple epochs using every thread
+         *
+         * Samples are shuffled every epoch. SYNCHRONOUS gives the same updates as Perceptron::train,
+         * HOGWILD gives each thread batchSize samples per update
+         *
+         * @param inputs :: Vector of input vectors
+         * @param targets :: Vector of target vectors (same order as inputs)
+         * @param epochs :: Number of complete passes through the training data
+         * @param lr :: Learning rate
+         * @param batchSize :: Samples per gradient step
+         * @param mode :: SYNCHRONOUS or HOGWILD
+         * @param verbose :: Print loss updates if true
+         */
+        void train(std::vector<std::vector<float>> &inputs,
+                   std::vector<std::vector<float>> &targets,
+                   int epochs, float lr, size_t batchSize, PARALLEL_MODE mode = SYNCHRONOUS, bool verbose = true) {
+
+            if(inputs.size() != targets.size()) {
+                throw std::invalid_argument("Incompatable input and target vector dimensions\n");
+            }
+            if(batchSize == 0) {
+                throw std::invalid_argument("Batch size must be at least 1\n");
+            }
+            if(inputs.empty()) {
+                return;
+            }
+
+            std::vector<size_t> order(inputs.size());
+            for(size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::mt19937 rng(std::random_device{}());
+            size_t workers = this->pool.size();
+
+            for(int epoch = 0; epoch < epochs; epoch++) {
+                float totalLoss = 0.0f;
+                std::shuffle(order.begin(), order.end(), rng);
+
+                switch(mode) {
+                    case SYNCHRONOUS: {
+                        for(size_t batch = 0; batch < order.size(); batch += batchSize) {
+                            size_t n = std::min(batchSize, order.size() - batch);
+
+                            //Every worker gathers its own shard straight from the sample vectors
+                            totalLoss += this->step_shards(n, lr, [&](size_t t, size_t start, size_t count) {
+                                Perceptron::gather_batch(inputs, targets, order, batch + start, count,
+                                                         this->shardX[t], this->shardY[t]);
+                            });
+                        }
+                        break;
+                    }
+                    case HOGWILD: {
+                        size_t base = order.size() / workers;
+                        size_t extra = order.size() % workers;
+
+                        this->pool.run([&](size_t t) {
+                            this->shardLoss[t] = 0;
+                            size_t start = t * base + std::min(t, extra);
+                            size_t end = start + base + (t < extra);
+
+                            for(size_t pos = start; pos < end; pos += batchSize) {
+                                size_t n = std::min(batchSize, end - pos);
+                                Perceptron::gather_batch(inputs, targets, order, pos, n, this->shardX[t], this->shardY[t]);
+                                this->run_shard(t);
+                                this->net.apply_gradients(this->replicas[t], lr / (float)n);
+                            }
+                        });
+
+                        for(size_t t = 0; t < workers; t++) {
+                            totalLoss += this->shardLoss[t];
+                        }
+                        break;
+                    }
+                }
+
+                totalLoss /= inputs.size();
+
+                if(verbose && (epoch % 100 == 0 || epoch == epochs-1)) {
+                    std::cout << "Epoch " << epoch << " | Loss: " << totalLoss << "\n";
+                }
+            }
+        }
+    };
+}
+
+
+
+#endif
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include "../../src/perceptron.h++"
+
+#define PARAMS_FILE "./Batch/batch_params.bin"
+
+//Every weight and bias of a network, read back through its saved file
+std::vector<float> params_of(perceptron::Perceptron &net) {
+    std::vector<float> params;
+    modelfile::MappedModel model;
+    if(!net.save_file(PARAMS_FILE) || !model.open(PARAMS_FILE)) {
+        return params;
+    }
+    for(const modelfile::LayerView &view : model.get_layers()) {
+        params.insert(params.end(), view.w, view.w + view.rows * view.cols);
+        params.insert(params.end(), view.b, view.b + view.rows);
+    }
+    return params;
+}
+
+int main() {
+    std::cout << "Mini-batch Test\n";
+    std::cout << "===============\n\n";
+
+    //4 inputs, 8 hidden, 6 hidden, 3 outputs
+    std::vector<size_t> layers = {4, 8, 6, 3};
+    std::vector<perceptron::ACTIVATION_FUNCTION> acts = {perceptron::RELU, perceptron::TANH, perceptron::SIGMOID};
+
+    perceptron::Perceptron net(layers, acts);
+    net.summary();
+
+    //Random batch of 5 samples, one sample per column
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    std::vector<std::vector<float>> samples(5, std::vector<float>(4));
+    matrix::Matrix<float> x(4, 5);
+    for(size_t j = 0; j < samples.size(); j++) {
+        for(size_t k = 0; k < 4; k++) {
+            samples[j][k] = dist(rng);
+            x.at(k, j) = samples[j][k];
+        }
+    }
+
+    //Batched forward should match the single sample forward for every column
+    std::cout << "Comparing forward_batch against forward...\n";
+    std::vector<std::vector<float>> single;
+    for(size_t j = 0; j < samples.size(); j++) {
+        single.push_back(net.forward(samples[j]));
+    }
+
+    const matrix::Matrix<float> &out = net.forward_batch(x);
+    float maxDiff = 0.0f;
+    for(size_t j = 0; j < samples.size(); j++) {
+        for(size_t k = 0; k < 3; k++) {
+            maxDiff = std::max(maxDiff, std::abs(out.at(k, j) - single[j][k]));
+        }
+    }
+
+    bool pass = true;
+    if(maxDiff < 1e-5f) {
+        std::cout << "PASS: Outputs match (max diff = " << maxDiff << ")\n\n";
+    } else {
+        std::cout << "FAIL: Outputs don't match (max diff = " << maxDiff << ")\n\n";
+        pass = false;
+    }
+
+    //One N sample backward_batch step must move the weights by the mean of the per-sample gradients
+    //Reference: N copies of the starting network, each taking a single sample step with lr / N
+    std::cout << "Comparing a backward_batch step against averaged single sample steps...\n";
+    float lr = 0.5f;
+    size_t n = samples.size();
+    matrix::Matrix<float> y(3, n);
+    std::vector<std::vector<float>> sampleTargets(n, std::vector<float>(3));
+    for(size_t j = 0; j < n; j++) {
+        for(size_t k = 0; k < 3; k++) {
+            sampleTargets[j][k] = (float)((j + k) % 2);
+            y.at(k, j) = sampleTargets[j][k];
+        }
+    }
+
+    std::vector<float> start = params_of(net);
+    std::vector<float> expected = start;
+    for(size_t j = 0; j < n; j++) {
+        perceptron::Perceptron copy = net;
+        copy.forward(samples[j]);
+        copy.backward(sampleTargets[j], lr / (float)n);
+        std::vector<float> stepped = params_of(copy);
+        for(size_t p = 0; p < expected.size(); p++) {
+            expected[p] += stepped[p] - start[p];
+        }
+    }
+
+    perceptron::Perceptron batched = net;
+    batched.forward_batch(x);
+    batched.backward_batch(y, lr);
+    std::vector<float> actual = params_of(batched);
+    std::remove(PARAMS_FILE);
+
+    float maxStep = 0.0f;
+    maxDiff = 0.0f;
+    for(size_t p = 0; p < expected.size() && actual.size() == expected.size(); p++) {
+        maxStep = std::max(maxStep, std::abs(expected[p] - start[p]));
+        maxDiff = std::max(maxDiff, std::abs(actual[p] - expected[p]));
+    }
+    bool averaged = !start.empty() && actual.size() == expected.size() && maxStep > 1e-3f && maxDiff < 1e-6f;
+    std::cout << (averaged ? "PASS" : "FAIL") << ": Weights match (max diff = " << maxDiff << ", largest step = " << maxStep << ")\n\n";
+    pass = pass && averaged;
+
+    //Train XOR with a batch holding the whole dataset
+    std::cout << "Training XOR with batch size 4...\n";
+    std::vector<size_t> xorLayers = {2, 8, 1};
+    std::vector<perceptron::ACTIVATION_FUNCTION> xorActs = {perceptron::TANH, perceptron::SIGMOID};
+    perceptron::Perceptron xorNet(xorLayers, xorActs);
+
+    std::vector<std::vector<float>> inputs = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    std::vector<std::vector<float>> targets = {{0}, {1}, {1}, {0}};
+    xorNet.train(inputs, targets, 5000, 2.0f, false, 4);
+
+    for(int i = 0; i < 4; i++) {
+        float o = xorNet.forward(inputs[i])[0];
+        int pred = (o > 0.5f) ? 1 : 0;
+        std::cout << inputs[i][0] << " XOR " << inputs[i][1] << " = " << o;
+        if(pred == targets[i][0]) {
+            std::cout << " PASS\n";
+        } else {
+            std::cout << " FAIL\n";
+            pass = false;
+        }
+    }
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "../../src/perceptron.h++"
+
+//CONFIGURATION - Change these values
+#define MIN_TIME_MS 20 //Each measurement repeats until it has run this long
+#define OUTPUT_FILE "./Benchmark/benchmark.json" //Override with ./benchmark <file>
+#define MODEL_FILE "./Benchmark/benchmark_model.bin"
+
+const std::vector<size_t> WIDTHS = {32, 128, 512};
+const std::vector<size_t> DEPTHS = {1, 2, 4}; //Hidden layers
+const std::vector<size_t> BATCHES = {1, 32, 256};
+const std::vector<perceptron::ACTIVATION_FUNCTION> ACTIVATIONS = {perceptron::RELU, perceptron::SIGMOID, perceptron::TANH};
+const size_t OUTPUTS = 10;
+
+
+/* Every heap allocation in the process goes through these, so a measurement can count the bytes it allocated */
+
+size_t allocatedBytes = 0;
+
+void *operator new(size_t size) {
+    allocatedBytes += size;
+    void *p = std::malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+    allocatedBytes += size;
+    size_t alignment = (size_t)align;
+    void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+
+typedef struct Result {
+    std::string op;
+    size_t width;
+    size_t depth;
+    const char *act;
+    size_t batch;
+    double nsPerOp;       //One call
+    double nsPerSample;   //One call divided by the batch size
+    double gflops;        //0 for file I/O
+    double bytesAllocated; //Per call, after one warm up call
+} Result;
+
+
+typedef struct Measurement {
+    double ns;
+    double bytes;
+} Measurement;
+
+
+//Warm up once, then double the repetitions until MIN_TIME_MS has passed
+template <typename F>
+Measurement measure(F f) {
+    f();
+
+    size_t reps = 1;
+    while(true) {
+        size_t before = allocatedBytes;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t r = 0; r < reps; r++) {
+            f();
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+        if(ns >= MIN_TIME_MS * 1e6) {
+            return {ns / reps, (double)(allocatedBytes - before) / reps};
+        }
+        reps *= 2;
+    }
+}
+
+
+const char *act_name(perceptron::ACTIVATION_FUNCTION act) {
+    switch(act) {
+        case perceptron::RELU:
+            return "relu";
+        case perceptron::SIGMOID:
+            return "sigmoid";
+        default:
+            return "tanh";
+    }
+}
+
+const char *isa_name(gemm::ISA isa) {
+    switch(isa) {
+        case gemm::AVX512:
+            return "avx512";
+        case gemm::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+
+//width inputs, depth hidden layers of width neurons, OUTPUTS outputs
+perceptron::Perceptron make_net(size_t width, size_t depth, perceptron::ACTIVATION_FUNCTION act) {
+    std::vector<size_t> layers(depth + 1, width);
+    layers.push_back(OUTPUTS);
+    std::vector<perceptron::ACTIVATION_FUNCTION> acts(depth + 1, act);
+    return perceptron::Perceptron(layers, acts);
+}
+
+//Multiply-adds per sample, times 2
+double forward_flops(size_t width, size_t depth) {
+    return 2.0 * ((double)depth * width * width + (double)width * OUTPUTS);
+}
+
+//Weight update for every layer plus W^T * dZ for every layer but the first
+double backward_flops(size_t width, size_t depth) {
+    return forward_flops(width, depth) + 2.0 * ((double)(depth - 1) * width * width + (double)width * OUTPUTS);
+}
+
+void fill(matrix::Matrix<float> &m, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for(size_t i = 0; i < m.get_rows(); i++) {
+        for(size_t j = 0; j < m.get_cols(); j++) {
+            m.at(i, j) = dist(rng);
+        }
+    }
+}
+
+
+bool write_json(std::string fileName, std::vector<Result> &results) {
+    FILE *file = std::fopen(fileName.c_str(), "w");
+    if(!file) {
+        return false;
+    }
+
+    std::fprintf(file, "{\n  \"isa\": \"%s\",\n  \"fast_math\": %s,\n  \"min_time_ms\": %d,\n  \"results\": [\n",
+                 isa_name(gemm::active_isa()), activation::fast_math() ? "true" : "false", MIN_TIME_MS);
+    for(size_t i = 0; i < results.size(); i++) {
+        Result &r = results[i];
+        std::fprintf(file, "    {\"op\": \"%s\", \"width\": %zu, \"depth\": %zu, \"activation\": \"%s\", \"batch\": %zu, "
+                     "\"ns_per_op\": %.1f, \"ns_per_sample\": %.1f, \"gflops\": %.3f, \"bytes_allocated\": %.0f}%s\n",
+                     r.op.c_str(), r.width, r.depth, r.act, r.batch, r.nsPerOp, r.nsPerSample, r.gflops, r.bytesAllocated,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+
+void print(Result &r) {
+    std::printf("%-15s | %5zu | %5zu | %-7s | %5zu | %12.1f | %8.2f | %10.0f\n",
+                r.op.c_str(), r.width, r.depth, r.act, r.batch, r.nsPerSample, r.gflops, r.bytesAllocated);
+}
+
+
+int main(int argc, char **argv) {
+    std::cout << "Benchmark\n";
+    std::cout << "=========\n\n";
+
+    std::string outputFile = argc > 1 ? argv[1] : OUTPUT_FILE;
+    std::mt19937 rng(11);
+    std::vector<Result> results;
+
+    std::cout << "ISA: " << isa_name(gemm::active_isa()) << ", each measurement runs for at least " << MIN_TIME_MS << " ms\n\n";
+    std::cout << "op              | width | depth | act     | batch |    ns/sample |  GFLOP/s | bytes/call\n";
+    std::cout << "----------------+-------+-------+---------+-------+--------------+----------+-----------\n";
+
+    //Matrix::multiply on the three products of a width x width layer
+    const char *products[] = {"W*X", "W^T*dZ", "dZ*A^T"};
+    for(size_t width : WIDTHS) {
+        for(size_t batch : BATCHES) {
+            for(int p = 0; p < 3; p++) {
+                matrix::Matrix<float> w(width, width), x(width, batch), out(width, batch);
+                fill(w, rng);
+                fill(x, rng);
+
+                Measurement m;
+                if(p < 2) {
+                    m = measure([&](void) { out.multiply(w, x, p == 1, false); });
+                } else {
+                    m = measure([&](void) { w.multiply(x, out, false, true); });
+                }
+
+                double flops = 2.0 * width * width * batch;
+                results.push_back({std::string("multiply ") + products[p], width, 0, "none", batch, m.ns, m.ns / batch, flops / m.ns, m.bytes});
+                print(results.back());
+            }
+        }
+    }
+
+    //forward_batch and backward_batch over every network shape
+    bool steadyState = true;
+    for(perceptron::ACTIVATION_FUNCTION act : ACTIVATIONS) {
+        for(size_t width : WIDTHS) {
+            for(size_t depth : DEPTHS) {
+                perceptron::Perceptron net = make_net(width, depth, act);
+
+                for(size_t batch : BATCHES) {
+                    matrix::Matrix<float> x(width, batch), y(OUTPUTS, batch);
+                    fill(x, rng);
+                    fill(y, rng);
+
+                    Measurement m = measure([&](void) { net.forward_batch(x); });
+                    results.push_back({"forward", width, depth, act_name(act), batch, m.ns, m.ns / batch, forward_flops(width, depth) * batch / m.ns, m.bytes});
+                    print(results.back());
+                    steadyState = steadyState && m.bytes == 0;
+
+                    //Backward reuses the activations of the last forward pass
+                    m = measure([&](void) { net.backward_batch(y, 1e-6f); });
+                    results.push_back({"backward", width, depth, act_name(act), batch, m.ns, m.ns / batch, backward_flops(width, depth) * batch / m.ns, m.bytes});
+                    print(results.back());
+                    steadyState = steadyState && m.bytes == 0;
+                }
+            }
+        }
+    }
+
+    //save_file and read_file, ns/sample is per call (batch 0)
+    bool fileOk = true;
+    for(size_t width : WIDTHS) {
+        for(size_t depth : DEPTHS) {
+            perceptron::Perceptron net = make_net(width, depth, perceptron::RELU);
+
+            Measurement m = measure([&](void) { fileOk = net.save_file(MODEL_FILE) && fileOk; });
+            results.push_back({"save_file", width, depth, "relu", 0, m.ns, m.ns, 0.0, m.bytes});
+            print(results.back());
+
+            m = measure([&](void) { fileOk = net.read_file(MODEL_FILE) && fileOk; });
+            results.push_back({"read_file", width, depth, "relu", 0, m.ns, m.ns, 0.0, m.bytes});
+            print(results.back());
+        }
+    }
+    std::remove(MODEL_FILE);
+
+    bool pass = true;
+    std::cout << "\n" << (steadyState ? "PASS" : "FAIL") << ": No heap allocations in steady state forward/backward\n";
+    pass = pass && steadyState;
+
+    std::cout << (fileOk ? "PASS" : "FAIL") << ": Every save_file/read_file succeeded\n";
+    pass = pass && fileOk;
+
+    bool written = write_json(outputFile, results);
+    std::cout << (written ? "PASS" : "FAIL") << ": Wrote " << results.size() << " results to " << outputFile << "\n";
+    pass = pass && written;
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
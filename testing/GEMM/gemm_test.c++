@@ -0,0 +1,228 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include "../../src/matrix.h++"
+#include "../../src/activation.h++"
+
+//Double precision reference for op(A) * op(B)
+std::vector<double> reference(bool transA, bool transB, size_t M, size_t N, size_t K,
+                              std::vector<float> &A, std::vector<float> &B) {
+    std::vector<double> C(M * N, 0.0);
+    for(size_t i = 0; i < M; i++) {
+        for(size_t j = 0; j < N; j++) {
+            double sum = 0;
+            for(size_t k = 0; k < K; k++) {
+                double a = transA ? A[k * M + i] : A[i * K + k];
+                double b = transB ? B[j * K + k] : B[k * N + j];
+                sum += a * b;
+            }
+            C[i * N + j] = sum;
+        }
+    }
+    return C;
+}
+
+const char *isa_name(gemm::ISA isa) {
+    switch(isa) {
+        case gemm::AVX512:
+            return "AVX-512";
+        case gemm::AVX2:
+            return "AVX2";
+        default:
+            return "Scalar";
+    }
+}
+
+int main() {
+    std::cout << "GEMM Test\n";
+    std::cout << "=========\n\n";
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    //M, N, K. Covers batch size 1, edge tiles and blocking boundaries
+    std::vector<std::vector<size_t>> shapes = {
+        {1, 1, 1}, {4, 1, 2}, {128, 1, 784}, {784, 1, 128}, {10, 1, 128},
+        {128, 784, 1}, {7, 13, 5}, {17, 33, 9}, {128, 32, 784},
+        {784, 32, 128}, {128, 784, 32}, {97, 2050, 300}, {300, 70, 513},
+    };
+
+    bool pass = true;
+    gemm::ISA detected = gemm::detected_isa();
+    std::cout << "Detected: " << isa_name(detected) << "\n";
+
+    for(int isa = gemm::SCALAR; isa <= detected; isa++) {
+        gemm::set_isa((gemm::ISA)isa);
+        float worst = 0.0f;
+
+        for(std::vector<size_t> &shape : shapes) {
+            size_t M = shape[0], N = shape[1], K = shape[2];
+
+            for(int t = 0; t < 4; t++) {
+                bool transA = t & 1;
+                bool transB = t & 2;
+
+                std::vector<float> A(M * K), B(K * N);
+                for(float &v : A) v = dist(rng);
+                for(float &v : B) v = dist(rng);
+
+                matrix::Matrix<float> a(transA ? K : M, transA ? M : K, A);
+                matrix::Matrix<float> b(transB ? N : K, transB ? K : N, B);
+                matrix::Matrix<float> c(M, N);
+                c.multiply(a, b, transA, transB);
+
+                std::vector<double> expected = reference(transA, transB, M, N, K, A, B);
+                for(size_t i = 0; i < M; i++) {
+                    for(size_t j = 0; j < N; j++) {
+                        //Error relative to the size of the dot product
+                        float err = std::abs(c.at(i, j) - expected[i * N + j]) / std::sqrt((float)K);
+                        worst = std::max(worst, err);
+                    }
+                }
+            }
+        }
+
+        std::cout << isa_name((gemm::ISA)isa) << ": max error " << worst;
+        if(worst < 1e-5f) {
+            std::cout << " PASS\n";
+        } else {
+            std::cout << " FAIL\n";
+            pass = false;
+        }
+
+        //C = relu(C + alpha * op(A) * op(B) + bias), the fused update and forward paths
+        worst = 0.0f;
+        for(std::vector<size_t> &shape : shapes) {
+            size_t M = shape[0], N = shape[1], K = shape[2];
+
+            for(int t = 0; t < 4; t++) {
+                bool transA = t & 1;
+                bool transB = t & 2;
+
+                std::vector<float> A(M * K), B(K * N), C(M * N), bias(M);
+                for(float &v : A) v = dist(rng);
+                for(float &v : B) v = dist(rng);
+                for(float &v : C) v = dist(rng);
+                for(float &v : bias) v = dist(rng);
+                std::vector<float> C0 = C;
+
+                gemm::Epilogue epilogue = {activation::bias_relu, bias.data(), NULL};
+                gemm::multiply(transA, transB, M, N, K, A.data(), transA ? M : K, B.data(), transB ? K : N,
+                               C.data(), N, -0.5f, true, &epilogue);
+
+                std::vector<double> expected = reference(transA, transB, M, N, K, A, B);
+                for(size_t i = 0; i < M; i++) {
+                    for(size_t j = 0; j < N; j++) {
+                        double v = C0[i * N + j] - 0.5 * expected[i * N + j] + bias[i];
+                        float err = std::abs(C[i * N + j] - std::max(v, 0.0)) / std::sqrt((float)K);
+                        worst = std::max(worst, err);
+                    }
+                }
+            }
+        }
+
+        std::cout << isa_name((gemm::ISA)isa) << ": alpha/accumulate/epilogue max error " << worst;
+        if(worst < 1e-5f) {
+            std::cout << " PASS\n";
+        } else {
+            std::cout << " FAIL\n";
+            pass = false;
+        }
+
+        //C = Hadamard(op(A) * op(B), G'(S)) with S laid out like C, the fused backward path
+        worst = 0.0f;
+        for(std::vector<size_t> &shape : shapes) {
+            size_t M = shape[0], N = shape[1], K = shape[2];
+
+            for(int t = 0; t < 4; t++) {
+                bool transA = t & 1;
+                bool transB = t & 2;
+
+                std::vector<float> A(M * K), B(K * N), C(M * N), S(M * N);
+                for(float &v : A) v = dist(rng);
+                for(float &v : B) v = dist(rng);
+                for(float &v : S) v = 0.5f + 0.5f * dist(rng);
+
+                gemm::Epilogue epilogue = {activation::derivative_sigmoid, NULL, S.data()};
+                gemm::multiply(transA, transB, M, N, K, A.data(), transA ? M : K, B.data(), transB ? K : N,
+                               C.data(), N, 1.0f, false, &epilogue);
+
+                std::vector<double> expected = reference(transA, transB, M, N, K, A, B);
+                for(size_t i = 0; i < M * N; i++) {
+                    double v = expected[i] * S[i] * (1 - S[i]);
+                    float err = std::abs(C[i] - v) / std::sqrt((float)K);
+                    worst = std::max(worst, err);
+                }
+            }
+        }
+
+        std::cout << isa_name((gemm::ISA)isa) << ": derivative epilogue max error " << worst;
+        if(worst < 1e-5f) {
+            std::cout << " PASS\n";
+        } else {
+            std::cout << " FAIL\n";
+            pass = false;
+        }
+
+        //Vectorized sigmoid/tanh against the standard library
+        if(isa != gemm::SCALAR) {
+            size_t n = 1003;
+            std::vector<float> z(n), sig(n), th(n);
+            for(size_t j = 0; j < n; j++) {
+                z[j] = -20.0f + 40.0f * j / (n - 1);
+            }
+            sig = z;
+            th = z;
+            float zero = 0.0f;
+            activation::set_fast_math(true);
+            activation::bias_sigmoid(sig.data(), n, 1, n, &zero, NULL);
+            activation::bias_tanh(th.data(), n, 1, n, &zero, NULL);
+            activation::set_fast_math(false);
+
+            float approx = 0.0f;
+            for(size_t j = 0; j < n; j++) {
+                approx = std::max(approx, std::abs(sig[j] - 1 / (1 + std::exp(-z[j]))));
+                approx = std::max(approx, std::abs(th[j] - std::tanh(z[j])));
+            }
+            std::cout << isa_name((gemm::ISA)isa) << ": fast sigmoid/tanh max error " << approx;
+            if(approx < 1e-5f) {
+                std::cout << " PASS\n";
+            } else {
+                std::cout << " FAIL\n";
+                pass = false;
+            }
+        }
+    }
+    gemm::set_isa(detected);
+
+    //Throughput on the shapes used by a 784-128-10 net with a batch of 32
+    std::cout << "\nThroughput (" << isa_name(gemm::active_isa()) << "):\n";
+    std::vector<std::vector<size_t>> hot = {{128, 32, 784}, {128, 32, 10}, {128, 784, 32}};
+    std::vector<std::vector<bool>> trans = {{false, false}, {true, false}, {false, true}};
+    const char *names[] = {"W * X       ", "W^T * dZ    ", "dZ * A^T    "};
+
+    for(size_t s = 0; s < hot.size(); s++) {
+        size_t M = hot[s][0], N = hot[s][1], K = hot[s][2];
+        bool transA = trans[s][0], transB = trans[s][1];
+
+        std::vector<float> A(M * K, 0.5f), B(K * N, 0.25f);
+        matrix::Matrix<float> a(transA ? K : M, transA ? M : K, A);
+        matrix::Matrix<float> b(transB ? N : K, transB ? K : N, B);
+        matrix::Matrix<float> c(M, N);
+
+        int reps = 200;
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++) {
+            c.multiply(a, b, transA, transB);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double gflops = 2.0 * M * N * K * reps / seconds / 1e9;
+        std::cout << "  " << names[s] << M << "x" << N << "x" << K << ": " << gflops << " GFLOP/s\n";
+    }
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
@@ -5,108 +5,48 @@
 #include <cmath>
 #include <random>
 #include <chrono>
-#include "../../src/perceptron.h++"
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include "../../src/inference.h++"
+#include "../../src/quantized.h++"
+#include "../../src/dataset.h++"
 
 int main() {
     std::cout << "Iris Test\n";
     std::cout << "=========\n\n";
     
     //Load the data - file is in same directory (IRIS/ folder)
-    std::ifstream file("./IRIS/iris.data");
-    if(!file.is_open()) {
+    dataset::Dataset data;
+    if(!data.load_csv("./IRIS/iris.data")) {
         std::cout << "Cant open iris.data, download from 'https://archive.ics.uci.edu/ml/machine-learning-databases/iris/iris.data' and place it in ./testing/IRIS/\n";
         return 1;
     }
     
-    std::vector<std::vector<float>> inputs;
-    std::vector<int> labels;
+    //Normalize each feature. Min/max ranges from UCI repo
+    //sepal length, sepal width, petal length, petal width
+    data.set_min_max({4.3f, 2.0f, 1.0f, 0.1f}, {7.9f, 4.4f, 6.9f, 2.5f});
     
-    std::string line;
-    while(std::getline(file, line)) {
-
-        if(line.length() == 0) continue;
-        
-        //Parse numbers - look for commas
-        std::vector<float> vec;
-        std::string num = "";
-        
-        for(int i = 0; i < (int)line.length(); i++) {
-            if(line[i] == ',') {
-                float val = std::stof(num);
-                vec.push_back(val);
-                num = "";
-            } else {
-
-                num = num + line[i];
-            }
-        }
-        
-        //Last thing left is the label
-        std::string labelName = num;
-        
-        //Normalize each feature. Min/max ranges from UCI repo
-        vec[0] = (vec[0] - 4.3f) / 3.6f;  //sepal length
-        vec[1] = (vec[1] - 2.0f) / 2.4f;  //sepal width
-        vec[2] = (vec[2] - 1.0f) / 5.9f;  //petal length
-        vec[3] = (vec[3] - 0.1f) / 2.4f;  //petal width
-        
-        inputs.push_back(vec);
-        
-        //Turn label string into number
-        if(labelName == "Iris-setosa") {
-            labels.push_back(0);
-        } else if(labelName == "Iris-versicolor") {
-            labels.push_back(1);
-        } else {
-            labels.push_back(2);
-        }
-    }
-    
-    std::cout << "Loaded " << inputs.size() << " flowers\n";
+    std::cout << "Loaded " << data.size() << " flowers\n";
     
     //Make a list of indices to shuffle
-    std::vector<int> order;
-    for(int i = 0; i < (int)inputs.size(); i++) {
+    std::vector<size_t> order;
+    for(size_t i = 0; i < data.size(); i++) {
         order.push_back(i);
     }
     
     //Shuffle - swap each index with a random one
     std::random_device rd;
     std::mt19937 rng(rd());
-    for(int i = (int)order.size() - 1; i > 0; i--) {
-        int j = rng() % (i + 1);
-        int temp = order[i];
-        order[i] = order[j];
-        order[j] = temp;
-    }
+    std::shuffle(order.begin(), order.end(), rng);
     
     //Split into train and test. 70% train, 30% test
-    int trainSize = 105;
+    size_t trainSize = 105;
+    std::vector<size_t> trainIdx(order.begin(), order.begin() + trainSize);
+    std::vector<size_t> testIdx(order.begin() + trainSize, order.end());
     
-    std::vector<std::vector<float>> trainIn;
-    std::vector<std::vector<float>> trainTarget;
-    std::vector<std::vector<float>> testIn;
-    std::vector<int> testLabel;
-    
-    for(int i = 0; i < (int)order.size(); i++) {
-        int idx = order[i];
-
-        if(i < trainSize) {
-            trainIn.push_back(inputs[idx]);
-            
-            //One-hot encoding for target
-            std::vector<float> target(3, 0.0f);
-            target[labels[idx]] = 1.0f;
-            trainTarget.push_back(target);
-
-        } else {
-            testIn.push_back(inputs[idx]);
-            testLabel.push_back(labels[idx]);
-        }
-    }
-    
-    std::cout << "Training samples: " << trainIn.size() << "\n";
-    std::cout << "Testing samples: " << testIn.size() << "\n\n";
+    std::cout << "Training samples: " << trainIdx.size() << "\n";
+    std::cout << "Testing samples: " << testIdx.size() << "\n\n";
     
     //Build network. 4 inputs, 6 hidden, 3 outputs
     std::vector<size_t> layers = {4, 6, 3};
@@ -119,18 +59,18 @@ int main() {
     std::cout << "Training...\n";
     auto startTime = std::chrono::steady_clock::now();
     
+    //Batches of one flower, shuffled every epoch on a background thread
+    dataset::BatchLoader loader(data, trainIdx, 1);
+    
     for(int epoch = 0; epoch < 300; epoch++) {
         float totalLoss = 0.0f;
         
         //Loop through all training samples
-        for(int i = 0; i < (int)trainIn.size(); i++) {
-
-            net.forward(trainIn[i]);
-            totalLoss = totalLoss + net.mse(trainTarget[i]);
-            net.backward(trainTarget[i], 0.15f);
+        while(dataset::Batch *batch = loader.next()) {
+            totalLoss = totalLoss + net.train_batch(batch->x, batch->y, 0.15f);
         }
         
-        totalLoss = totalLoss / trainIn.size();
+        totalLoss = totalLoss / trainIdx.size();
         
         //Print every 100 epochs
         if(epoch % 100 == 0 || epoch == 299) {
@@ -145,9 +85,10 @@ int main() {
     //Test on unseen data
     std::cout << "\nTesting...\n";
     int correct = 0;
-    for(int i = 0; i < (int)testIn.size(); i++) {
+    for(size_t i = 0; i < testIdx.size(); i++) {
 
-        const std::vector<float>& out = net.forward(testIn[i]);
+        std::vector<float> flower = data.sample_vector(testIdx[i]);
+        const std::vector<float>& out = net.forward(flower);
         
         //Pick class with highest output
         int guess = 0;
@@ -159,15 +100,132 @@ int main() {
             }
         }
         
-        if(guess == testLabel[i]) {
+        if(guess == data.label(testIdx[i])) {
             correct++;
         }
     }
     
-    float acc = 100.0f * correct / testIn.size();
+    float acc = 100.0f * correct / testIdx.size();
     std::cout << "\nAccuracy: " << acc << "%\n";
     
-    if(acc > 90.0f) {
+    //Same test set through the fp32 inference model and its int8 quantization
+    std::cout << "\nQuantizing to int8...\n";
+    perceptron::InferenceModel fp32(net);
+    perceptron::QuantizedModel int8(net);
+    perceptron::Workspace fp32Ws(fp32);
+    perceptron::QuantizedWorkspace int8Ws(int8);
+    
+    std::vector<std::vector<float>> flowers;
+    for(size_t i = 0; i < testIdx.size(); i++) {
+        flowers.push_back(data.sample_vector(testIdx[i]));
+    }
+    
+    int correctInt8 = 0;
+    int agree = 0;
+    for(size_t i = 0; i < flowers.size(); i++) {
+        int guess = int8.predict_class(flowers[i], int8Ws);
+        correctInt8 += guess == data.label(testIdx[i]);
+        agree += guess == fp32.predict_class(flowers[i], fp32Ws);
+    }
+    
+    //The whole test set as one int8 batch must give the same outputs as one flower at a time
+    std::vector<float> batch(4 * flowers.size());
+    for(size_t j = 0; j < flowers.size(); j++) {
+        for(size_t k = 0; k < 4; k++) {
+            batch[k * flowers.size() + j] = flowers[j][k];
+        }
+    }
+    perceptron::QuantizedWorkspace batchWs(int8, flowers.size());
+    const float *batchOut = int8.forward(batch.data(), flowers.size(), batchWs);
+    float batchDiff = 0.0f;
+    for(size_t j = 0; j < flowers.size(); j++) {
+        const float *single = int8.forward(flowers[j], int8Ws);
+        for(size_t k = 0; k < 3; k++) {
+            batchDiff = std::max(batchDiff, std::abs(batchOut[k * flowers.size() + j] - single[k]));
+        }
+    }
+    
+    //Tiny network, so repeat the test set to get a measurable time
+    auto fp32Start = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < 1000; pass++) {
+        for(std::vector<float> &flower : flowers) {
+            fp32.predict_class(flower, fp32Ws);
+        }
+    }
+    auto int8Start = std::chrono::steady_clock::now();
+    for(int pass = 0; pass < 1000; pass++) {
+        for(std::vector<float> &flower : flowers) {
+            int8.predict_class(flower, int8Ws);
+        }
+    }
+    auto int8End = std::chrono::steady_clock::now();
+    double fp32Ns = std::chrono::duration<double, std::nano>(int8Start - fp32Start).count() / (1000.0 * flowers.size());
+    double int8Ns = std::chrono::duration<double, std::nano>(int8End - int8Start).count() / (1000.0 * flowers.size());
+    
+    float accInt8 = 100.0f * correctInt8 / testIdx.size();
+    std::cout << "int8 accuracy: " << accInt8 << "% (fp32 " << acc << "%, " << agree << "/" << flowers.size() << " predictions agree)\n";
+    std::cout << "Per sample: fp32 " << fp32Ns << " ns, int8 " << int8Ns << " ns (" << fp32Ns / int8Ns << "x)\n";
+    std::cout << "Weights: fp32 " << fp32.weight_bytes() << " bytes, int8 " << int8.weight_bytes() << " bytes\n";
+    std::cout << "int8 batch vs single sample max diff: " << batchDiff << "\n\n";
+    
+    //Long class names stay distinct, and the loader refuses indices past the end of the dataset
+    std::string longName(80, 'x');
+    std::ofstream csv("./IRIS/long_names.csv");
+    csv << "1.5,2.5," << longName << "a\n" << "0.5,1.0," << longName << "b\n";
+    csv.close();
+    dataset::Dataset named;
+    bool distinct = named.load_csv("./IRIS/long_names.csv") && named.class_count() == 2 &&
+                    named.class_names()[1] == longName + "b";
+    std::remove("./IRIS/long_names.csv");
+    std::cout << (distinct ? "PASS" : "FAIL") << ": Class names longer than 64 characters kept whole\n";
+
+    //Numeric columns must be whole numbers, trailing junk is not dropped
+    bool strict = true;
+    std::vector<std::string> malformed = {"5.1x,1.0,a\n", "1e,1.0,a\n", "1.0,,a\n"};
+    for(std::string &line : malformed) {
+        std::ofstream bad("./IRIS/malformed.csv");
+        bad << "0.5,1.0,a\n" << line;
+        bad.close();
+        dataset::Dataset badData;
+        strict = strict && !badData.load_csv("./IRIS/malformed.csv");
+    }
+    std::ofstream spaced("./IRIS/malformed.csv");
+    spaced << " 0.5 ,1.0\t,a\n";
+    spaced.close();
+    dataset::Dataset spacedData;
+    strict = strict && spacedData.load_csv("./IRIS/malformed.csv") && spacedData.size() == 1;
+    std::remove("./IRIS/malformed.csv");
+    std::cout << (strict ? "PASS" : "FAIL") << ": Malformed numbers rejected, surrounding spaces allowed\n";
+
+    //IDX header of 4 images of 2^31 x 2^31 pixels, the total pixel count wraps to 0 in 64 bits
+    auto write_idx = [](const char *name, std::vector<uint32_t> header, size_t payload) {
+        std::ofstream out(name, std::ios::binary);
+        for(uint32_t v : header) {
+            unsigned char be[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v};
+            out.write((const char *)be, 4);
+        }
+        std::string zeros(payload, '\0');
+        out.write(zeros.data(), zeros.size());
+    };
+    write_idx("./IRIS/labels.idx", {0x801, 4}, 4);
+    write_idx("./IRIS/images.idx", {0x803, 4, 0x80000000u, 0x80000000u}, 16);
+    dataset::Dataset idx;
+    bool crafted = !idx.load_idx("./IRIS/images.idx", "./IRIS/labels.idx");
+    write_idx("./IRIS/images.idx", {0x803, 4, 2, 2}, 16);
+    crafted = crafted && idx.load_idx("./IRIS/images.idx", "./IRIS/labels.idx") && idx.size() == 4;
+    std::remove("./IRIS/images.idx");
+    std::remove("./IRIS/labels.idx");
+    std::cout << (crafted ? "PASS" : "FAIL") << ": IDX header with an overflowing size rejected\n";
+
+    bool rejected = false;
+    try {
+        dataset::BatchLoader badLoader(data, {0, data.size()}, 2);
+    } catch(const std::out_of_range &) {
+        rejected = true;
+    }
+    std::cout << (rejected ? "PASS" : "FAIL") << ": Out of range sample index rejected\n\n";
+
+    if(acc > 90.0f && accInt8 > 90.0f && batchDiff < 1e-6f && distinct && strict && crafted && rejected) {
         std::cout << "PASS\n";
     } else {
         std::cout << "FAIL\n";
@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include "../../src/inference.h++"
+#include "../../src/quantized.h++"
+
+//CONFIGURATION - Change these values
+#define CLIENTS 8
+#define REQUESTS 500 //Per client
+#define MAX_BATCH 8
+#define MAX_WAIT_US 200
+
+//Latency percentile in microseconds
+double percentile(std::vector<double> &latencies, double p) {
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[(size_t)(p * (latencies.size() - 1))];
+}
+
+//Run every client on its own thread, each calling predict for its slice of the inputs
+template <typename Predict>
+void run_clients(std::vector<std::vector<float>> &inputs, std::vector<int> &labels, std::vector<double> &latencies, Predict predict) {
+    std::vector<std::thread> clients;
+    for(size_t c = 0; c < CLIENTS; c++) {
+        clients.emplace_back([&, c](void) {
+            for(size_t r = 0; r < REQUESTS; r++) {
+                size_t idx = c * REQUESTS + r;
+                auto start = std::chrono::steady_clock::now();
+                labels[idx] = predict(c, inputs[idx]);
+                auto end = std::chrono::steady_clock::now();
+                latencies[idx] = std::chrono::duration<double, std::micro>(end - start).count();
+            }
+        });
+    }
+    for(std::thread &client : clients) {
+        client.join();
+    }
+}
+
+int main() {
+    std::cout << "Inference Engine Test\n";
+    std::cout << "=====================\n\n";
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    //MNIST sized network on random data
+    std::vector<size_t> layers = {784, 128, 10};
+    std::vector<perceptron::ACTIVATION_FUNCTION> acts = {perceptron::RELU, perceptron::SIGMOID};
+    perceptron::Perceptron net(layers, acts);
+
+    std::vector<std::vector<float>> inputs(CLIENTS * REQUESTS, std::vector<float>(784));
+    for(std::vector<float> &input : inputs) {
+        for(float &v : input) {
+            v = dist(rng);
+        }
+    }
+
+    std::vector<int> expected(inputs.size());
+    for(size_t i = 0; i < inputs.size(); i++) {
+        expected[i] = net.predict_class(inputs[i]);
+    }
+
+    bool pass = true;
+    perceptron::InferenceModel model(net);
+
+    //Batched forward through a workspace must match the training network sample by sample
+    std::cout << "Comparing a batched workspace forward against Perceptron::forward...\n";
+    size_t n = 16;
+    std::vector<float> x(784 * n);
+    for(size_t j = 0; j < n; j++) {
+        for(size_t k = 0; k < 784; k++) {
+            x[k * n + j] = inputs[j][k];
+        }
+    }
+    perceptron::Workspace ws(model, n);
+    const float *out = model.forward(x.data(), n, ws);
+    float diff = 0.0f;
+    for(size_t j = 0; j < n; j++) {
+        const std::vector<float> &ref = net.forward(inputs[j]);
+        for(size_t k = 0; k < 10; k++) {
+            diff = std::max(diff, std::abs(out[k * n + j] - ref[k]));
+        }
+    }
+    std::cout << (diff < 1e-5f ? "PASS" : "FAIL") << ": Outputs match (max diff = " << diff << ")\n\n";
+    pass = pass && diff < 1e-5f;
+
+    //One int8 workspace reused by a wide model at batch 1, then a narrow model at a larger batch
+    std::cout << "Reusing an int8 workspace across models and batch sizes...\n";
+    std::vector<size_t> smallLayers = {4, 8, 3};
+    std::vector<perceptron::ACTIVATION_FUNCTION> smallActs = {perceptron::RELU, perceptron::SIGMOID};
+    perceptron::Perceptron smallNet(smallLayers, smallActs);
+    perceptron::QuantizedModel wide(net);
+    perceptron::QuantizedModel narrow(smallNet);
+
+    perceptron::QuantizedWorkspace sharedWs(wide, 1);
+    wide.forward(inputs[0], sharedWs);
+
+    size_t smallBatch = 8;
+    std::vector<float> smallX(4 * smallBatch);
+    for(float &v : smallX) {
+        v = dist(rng);
+    }
+    const float *reused = narrow.forward(smallX.data(), smallBatch, sharedWs);
+    std::vector<float> reusedOut(reused, reused + 3 * smallBatch);
+
+    perceptron::QuantizedWorkspace freshWs(narrow, smallBatch);
+    const float *fresh = narrow.forward(smallX.data(), smallBatch, freshWs);
+    diff = 0.0f;
+    for(size_t k = 0; k < reusedOut.size(); k++) {
+        diff = std::max(diff, std::abs(reusedOut[k] - fresh[k]));
+    }
+    std::cout << (diff == 0.0f ? "PASS" : "FAIL") << ": Reused workspace matches a fresh one (max diff = " << diff << ")\n\n";
+    pass = pass && diff == 0.0f;
+
+    std::vector<int> labels(inputs.size());
+    std::vector<double> latencies(inputs.size());
+
+    //Every client shares the model, each with its own workspace
+    std::cout << CLIENTS << " clients x " << REQUESTS << " requests\n";
+    std::vector<perceptron::Workspace> workspaces;
+    for(size_t c = 0; c < CLIENTS; c++) {
+        workspaces.emplace_back(model, 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    run_clients(inputs, labels, latencies, [&](size_t c, std::vector<float> &input) {
+        return model.predict_class(input, workspaces[c]);
+    });
+    auto end = std::chrono::steady_clock::now();
+    double directRate = inputs.size() / std::chrono::duration<double>(end - start).count();
+    double directP50 = percentile(latencies, 0.5);
+    double directP99 = percentile(latencies, 0.99);
+
+    bool match = labels == expected;
+    std::cout << (match ? "PASS" : "FAIL") << ": Shared model with per thread workspaces matches\n";
+    pass = pass && match;
+
+    //Same load through the batching server
+    perceptron::InferenceServer server(model, MAX_BATCH, std::chrono::microseconds(MAX_WAIT_US));
+
+    start = std::chrono::steady_clock::now();
+    run_clients(inputs, labels, latencies, [&](size_t, std::vector<float> &input) {
+        return server.predict_class(input);
+    });
+    end = std::chrono::steady_clock::now();
+    double serverRate = inputs.size() / std::chrono::duration<double>(end - start).count();
+    double serverP50 = percentile(latencies, 0.5);
+    double serverP99 = percentile(latencies, 0.99);
+
+    match = labels == expected;
+    std::cout << (match ? "PASS" : "FAIL") << ": Batching server matches\n";
+    pass = pass && match;
+
+    std::vector<float> served;
+    server.predict(inputs[0], served);
+    const std::vector<float> &ref = net.forward(inputs[0]);
+    diff = 0.0f;
+    for(size_t k = 0; k < ref.size(); k++) {
+        diff = std::max(diff, std::abs(served[k] - ref[k]));
+    }
+    std::cout << (diff < 1e-5f ? "PASS" : "FAIL") << ": Server outputs match (max diff = " << diff << ")\n\n";
+    pass = pass && diff < 1e-5f;
+
+    //Several workers share one queue. A worker that finds it drained must not count an empty batch
+    perceptron::InferenceServer pool(model, MAX_BATCH, std::chrono::microseconds(MAX_WAIT_US), 2);
+    std::vector<double> poolLatencies(inputs.size());
+    run_clients(inputs, labels, poolLatencies, [&](size_t, std::vector<float> &input) {
+        return pool.predict_class(input);
+    });
+    match = labels == expected && pool.mean_batch_size() >= 1.0;
+    std::cout << (match ? "PASS" : "FAIL") << ": Two worker server matches (mean batch " << pool.mean_batch_size() << ")\n\n";
+    pass = pass && match;
+
+    std::cout << "mode              | requests/s |   p50 us |   p99 us\n";
+    std::printf("shared workspaces | %10.0f | %8.1f | %8.1f\n", directRate, directP50, directP99);
+    std::printf("batching server   | %10.0f | %8.1f | %8.1f\n", serverRate, serverP50, serverP99);
+    std::cout << "Mean server batch: " << server.mean_batch_size() << " requests\n\n";
+
+    //Memory per serving thread: a full network copy against a workspace
+    size_t copyBytes = model.weight_bytes() + (784 + 128 + 10) * sizeof(float);
+    std::cout << "Shared weights: " << model.weight_bytes() << " bytes\n";
+    std::cout << "Per thread: " << workspaces[0].bytes() << " bytes (workspace) vs "
+              << copyBytes << " bytes (network copy)\n";
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
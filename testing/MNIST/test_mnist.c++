@@ -6,7 +6,9 @@
 #include <random>
 #include <chrono>
 #include <cstdint>
-#include "../../src/perceptron.h++"
+#include "../../src/inference.h++"
+#include "../../src/quantized.h++"
+#include "../../src/dataset.h++"
 
 //CONFIGURATION - Change these values
 #define TRAIN_SAMPLES 10000   //Max 60000
@@ -14,71 +16,7 @@
 #define EPOCHS 10
 #define LEARNING_RATE 0.1f
 #define HIDDEN_NEURONS 128
-
-//Simple MNIST reader - no fancy stuff
-std::vector<std::vector<float>> read_mnist_images(std::string filename, int maxCount) {
-    std::ifstream file(filename, std::ios::binary);
-    if(!file.is_open()) {
-        return {};
-    }
-    
-    //Read header
-    uint32_t magic, numImages, rows, cols;
-    file.read((char*)&magic, 4);
-    file.read((char*)&numImages, 4);
-    file.read((char*)&rows, 4);
-    file.read((char*)&cols, 4);
-    
-    //Swap endian (MNIST uses big-endian)
-    magic = __builtin_bswap32(magic);
-    numImages = __builtin_bswap32(numImages);
-    rows = __builtin_bswap32(rows);
-    cols = __builtin_bswap32(cols);
-    
-    int limit = maxCount < (int)numImages ? maxCount : numImages;
-    
-    std::vector<std::vector<float>> images;
-    images.reserve(limit);
-    
-    for(int i = 0; i < limit; i++) {
-        std::vector<float> img(rows * cols);
-        for(int j = 0; j < rows * cols; j++) {
-            unsigned char pixel;
-            file.read((char*)&pixel, 1);
-            img[j] = pixel / 255.0f;
-        }
-        images.push_back(img);
-    }
-    
-    return images;
-}
-
-std::vector<int> read_mnist_labels(std::string filename, int maxCount) {
-    std::ifstream file(filename, std::ios::binary);
-    if(!file.is_open()) {
-        return {};
-    }
-    
-    uint32_t magic, numLabels;
-    file.read((char*)&magic, 4);
-    file.read((char*)&numLabels, 4);
-    
-    magic = __builtin_bswap32(magic);
-    numLabels = __builtin_bswap32(numLabels);
-    
-    int limit = maxCount < (int)numLabels ? maxCount : numLabels;
-    
-    std::vector<int> labels;
-    labels.reserve(limit);
-    
-    for(int i = 0; i < limit; i++) {
-        unsigned char label;
-        file.read((char*)&label, 1);
-        labels.push_back(label);
-    }
-    
-    return labels;
-}
+#define BATCH_SIZE 1          //Raise along with LEARNING_RATE for faster epochs
 
 int main() {
     std::cout << "MNIST Test\n";
@@ -89,13 +27,17 @@ int main() {
     std::cout << "  Test samples: " << TEST_SAMPLES << "\n";
     std::cout << "  Epochs: " << EPOCHS << "\n";
     std::cout << "  Learning rate: " << LEARNING_RATE << "\n";
-    std::cout << "  Hidden neurons: " << HIDDEN_NEURONS << "\n\n";
+    std::cout << "  Hidden neurons: " << HIDDEN_NEURONS << "\n";
+    std::cout << "  Batch size: " << BATCH_SIZE << "\n\n";
     
-    //Load data - simple paths like Iris
+    //Load data - simple paths like Iris. Images are mapped, not copied
     std::cout << "Loading MNIST data...\n";
+    auto loadStart = std::chrono::steady_clock::now();
     
-    auto trainImages = read_mnist_images("MNIST/train-images-idx3-ubyte", TRAIN_SAMPLES);
-    if(trainImages.empty()) {
+    dataset::Dataset train;
+    dataset::Dataset test;
+    if(!train.load_idx("MNIST/train-images-idx3-ubyte", "MNIST/train-labels-idx1-ubyte", TRAIN_SAMPLES) ||
+       !test.load_idx("MNIST/t10k-images-idx3-ubyte", "MNIST/t10k-labels-idx1-ubyte", TEST_SAMPLES)) {
         std::cout << "Cant open MNIST/train-images-idx3-ubyte\n";
         std::cout << "Download from:\n";
         std::cout << "  wget https://storage.googleapis.com/cvdf-datasets/mnist/train-images-idx3-ubyte.gz\n";
@@ -106,12 +48,10 @@ int main() {
         return 1;
     }
     
-    auto trainLabels = read_mnist_labels("MNIST/train-labels-idx1-ubyte", TRAIN_SAMPLES);
-    auto testImages = read_mnist_images("MNIST/t10k-images-idx3-ubyte", TEST_SAMPLES);
-    auto testLabels = read_mnist_labels("MNIST/t10k-labels-idx1-ubyte", TEST_SAMPLES);
-    
-    std::cout << "Train: " << trainImages.size() << " samples\n";
-    std::cout << "Test: " << testImages.size() << " samples\n\n";
+    auto loadEnd = std::chrono::steady_clock::now();
+    std::cout << "Train: " << train.size() << " samples\n";
+    std::cout << "Test: " << test.size() << " samples\n";
+    std::cout << "Loading took " << std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() << " ms\n\n";
     
     //Build network
     std::vector<size_t> layers = {784, HIDDEN_NEURONS, 10};
@@ -120,28 +60,19 @@ int main() {
     perceptron::Perceptron net(layers, acts);
     net.summary();
     
-    //Prepare training targets (one-hot)
-    std::vector<std::vector<float>> trainTargets;
-    for(int i = 0; i < (int)trainLabels.size(); i++) {
-        std::vector<float> target(10, 0.0f);
-        target[trainLabels[i]] = 1.0f;
-        trainTargets.push_back(target);
-    }
-    
-    //Train
+    //Train. Batches are shuffled, normalised and one-hot encoded on a background thread
     std::cout << "Training...\n";
     auto startTime = std::chrono::steady_clock::now();
+    dataset::BatchLoader loader(train, {}, BATCH_SIZE);
     
     for(int epoch = 0; epoch < EPOCHS; epoch++) {
         float totalLoss = 0.0f;
         
-        for(int i = 0; i < (int)trainImages.size(); i++) {
-            net.forward(trainImages[i]);
-            totalLoss += net.mse(trainTargets[i]);
-            net.backward(trainTargets[i], LEARNING_RATE);
+        while(dataset::Batch *batch = loader.next()) {
+            totalLoss += net.train_batch(batch->x, batch->y, LEARNING_RATE) * batch->size;
         }
         
-        totalLoss /= trainImages.size();
+        totalLoss /= train.size();
         std::cout << "Epoch " << epoch + 1 << " loss: " << totalLoss << "\n";
     }
     
@@ -152,10 +83,12 @@ int main() {
     //Test
     std::cout << "\nTesting...\n";
     int correct = 0;
+    std::vector<float> image(test.feature_count());
 
 
-    for(int i = 0; i < (int)testImages.size(); i++) {
-        const std::vector<float>& out = net.forward(testImages[i]);
+    for(int i = 0; i < (int)test.size(); i++) {
+        test.sample(i, image.data());
+        const std::vector<float>& out = net.forward(image);
         
         int guess = 0;
         float best = out[0];
@@ -166,26 +99,61 @@ int main() {
             }
         }
         
-        if(guess == testLabels[i]) {
+        if(guess == test.label(i)) {
             correct++;
         }
     }
     
-    float acc = 100.0f * correct / testImages.size();
+    float acc = 100.0f * correct / test.size();
     std::cout << "Accuracy: " << acc << "%\n";
     
+    //Same test set through the fp32 inference model and its int8 quantization
+    std::cout << "\nQuantizing to int8...\n";
+    perceptron::InferenceModel fp32(net);
+    perceptron::QuantizedModel int8(net);
+    perceptron::Workspace fp32Ws(fp32);
+    perceptron::QuantizedWorkspace int8Ws(int8);
+    
+    std::vector<std::vector<float>> images(test.size());
+    for(size_t i = 0; i < test.size(); i++) {
+        images[i] = test.sample_vector(i);
+    }
+    
+    int correctFp32 = 0;
+    auto fp32Start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < images.size(); i++) {
+        correctFp32 += fp32.predict_class(images[i], fp32Ws) == test.label(i);
+    }
+    auto int8Start = std::chrono::steady_clock::now();
+    int correctInt8 = 0;
+    for(size_t i = 0; i < images.size(); i++) {
+        correctInt8 += int8.predict_class(images[i], int8Ws) == test.label(i);
+    }
+    auto int8End = std::chrono::steady_clock::now();
+    double fp32Us = std::chrono::duration<double, std::micro>(int8Start - fp32Start).count() / images.size();
+    double int8Us = std::chrono::duration<double, std::micro>(int8End - int8Start).count() / images.size();
+    
+    float accFp32 = 100.0f * correctFp32 / test.size();
+    float accInt8 = 100.0f * correctInt8 / test.size();
+    std::cout << "fp32 accuracy: " << accFp32 << "%, int8 accuracy: " << accInt8 << "% (drop " << accFp32 - accInt8 << " points)\n";
+    std::cout << "Per sample: fp32 " << fp32Us << " us, int8 " << int8Us << " us (" << fp32Us / int8Us << "x speedup)\n";
+    std::cout << "Weights: fp32 " << fp32.weight_bytes() << " bytes, int8 " << int8.weight_bytes() << " bytes ("
+              << (float)fp32.weight_bytes() / int8.weight_bytes() << "x smaller)\n";
+    std::cout << (accFp32 - accInt8 < 1.0f ? "PASS" : "FAIL") << ": int8 within 1 point of fp32\n";
+    
 
     //Show some predictions
     std::cout << "\nSample predictions:\n";
     for(int i = 0; i < 10; i++) {
-        const std::vector<float>& out = net.forward(testImages[i]);
+        test.sample(i, image.data());
+        const std::vector<float>& out = net.forward(image);
         
         int guess = 0;
         for(int j = 1; j < 10; j++) {
             if(out[j] > out[guess]) guess = j;
         }
-        std::cout << "  Predicted: " << guess << " | Actual: " << testLabels[i];
-        if(guess == testLabels[i]) std::cout << " Y";
+        std::cout << "  Predicted: " << guess << " | Actual: " << test.label(i);
+        if(guess == test.label(i)) std::cout << " Y";
         else std::cout << " N";
         std::cout << "\n";
     }
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include "../../src/trainer.h++"
+
+//CONFIGURATION - Change these values
+#define BENCH_SAMPLES 4096
+#define BENCH_EPOCHS 2
+#define BATCH_SIZE 256
+#define HOGWILD_TOLERANCE 1.25f //HOGWILD loss may be at most this times the SYNCHRONOUS loss
+
+//Largest difference between two networks on a set of probe inputs
+float max_output_diff(perceptron::Perceptron &a, perceptron::Perceptron &b, std::vector<std::vector<float>> &probes) {
+    float worst = 0.0f;
+    for(std::vector<float> &probe : probes) {
+        std::vector<float> outA = a.forward(probe);
+        const std::vector<float> &outB = b.forward(probe);
+        for(size_t i = 0; i < outA.size(); i++) {
+            worst = std::max(worst, std::abs(outA[i] - outB[i]));
+        }
+    }
+    return worst;
+}
+
+//Mean squared error over a data set
+float mean_loss(perceptron::Perceptron &net, std::vector<std::vector<float>> &inputs, std::vector<std::vector<float>> &targets) {
+    double sum = 0.0;
+    for(size_t i = 0; i < inputs.size(); i++) {
+        const std::vector<float> &out = net.forward(inputs[i]);
+        for(size_t k = 0; k < out.size(); k++) {
+            sum += (out[k] - targets[i][k]) * (out[k] - targets[i][k]);
+        }
+    }
+    return (float)(sum / (inputs.size() * targets[0].size()));
+}
+
+int main(int argc, char **argv) {
+    std::cout << "Parallel Training Test\n";
+    std::cout << "======================\n\n";
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    //MNIST sized network on random data
+    std::vector<size_t> layers = {784, 128, 10};
+    std::vector<perceptron::ACTIVATION_FUNCTION> acts = {perceptron::RELU, perceptron::SIGMOID};
+
+    std::vector<std::vector<float>> inputs(BENCH_SAMPLES, std::vector<float>(784));
+    std::vector<std::vector<float>> targets(BENCH_SAMPLES, std::vector<float>(10, 0.0f));
+    for(size_t i = 0; i < inputs.size(); i++) {
+        for(float &v : inputs[i]) {
+            v = dist(rng);
+        }
+        targets[i][i % 10] = 1.0f;
+    }
+    std::vector<std::vector<float>> probes(inputs.begin(), inputs.begin() + 8);
+
+    //One synchronous step must match the single threaded batch step
+    std::cout << "Comparing a 4 thread step against backward_batch...\n";
+    perceptron::Perceptron serial(layers, acts);
+    perceptron::Perceptron parallelA = serial;
+    perceptron::Perceptron parallelB = serial;
+
+    matrix::Matrix<float> x(784, 37);
+    matrix::Matrix<float> y(10, 37);
+    for(size_t j = 0; j < 37; j++) {
+        for(size_t k = 0; k < 784; k++) {
+            x.at(k, j) = inputs[j][k];
+        }
+        for(size_t k = 0; k < 10; k++) {
+            y.at(k, j) = targets[j][k];
+        }
+    }
+
+    serial.forward_batch(x);
+    serial.backward_batch(y, 0.5f);
+    perceptron::ParallelTrainer trainerA(parallelA, 4);
+    perceptron::ParallelTrainer trainerB(parallelB, 4);
+    trainerA.step(x, y, 0.5f);
+    trainerB.step(x, y, 0.5f);
+
+    bool pass = true;
+    float diff = max_output_diff(serial, parallelA, probes);
+    std::cout << (diff < 1e-5f ? "PASS" : "FAIL") << ": Matches serial step (max diff = " << diff << ")\n";
+    pass = pass && diff < 1e-5f;
+
+    diff = max_output_diff(parallelA, parallelB, probes);
+    std::cout << (diff == 0.0f ? "PASS" : "FAIL") << ": Deterministic across runs (max diff = " << diff << ")\n\n";
+    pass = pass && diff == 0.0f;
+
+    //Scaling benchmark, up to the hardware thread count unless given on the command line
+    size_t hardware = std::thread::hardware_concurrency();
+    if(argc > 1) {
+        hardware = std::strtoul(argv[1], NULL, 10);
+    }
+    if(hardware == 0) {
+        hardware = 1;
+    }
+    std::vector<size_t> counts;
+    for(size_t t = 1; t < hardware; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(hardware);
+
+    std::cout << "Scaling (" << BENCH_SAMPLES << " samples x " << BENCH_EPOCHS << " epochs, batch " << BATCH_SIZE << ")\n";
+    std::cout << "threads | mode        | samples/s | efficiency | loss\n";
+
+    //Every run starts from the same weights, so the losses after training are comparable
+    perceptron::Perceptron untrained(layers, acts);
+    float startLoss = mean_loss(untrained, inputs, targets);
+    bool trains = true;
+
+    double baseline = 0.0;
+    for(size_t t : counts) {
+        float syncLoss = 0.0f;
+        for(int mode = perceptron::SYNCHRONOUS; mode <= perceptron::HOGWILD; mode++) {
+            perceptron::Perceptron net = untrained;
+            perceptron::ParallelTrainer trainer(net, t);
+
+            auto start = std::chrono::steady_clock::now();
+            trainer.train(inputs, targets, BENCH_EPOCHS, 0.5f, BATCH_SIZE, (perceptron::PARALLEL_MODE)mode, false);
+            auto end = std::chrono::steady_clock::now();
+
+            double rate = BENCH_SAMPLES * BENCH_EPOCHS / std::chrono::duration<double>(end - start).count();
+            if(t == 1 && mode == perceptron::SYNCHRONOUS) {
+                baseline = rate;
+            }
+            float loss = mean_loss(net, inputs, targets);
+            std::printf("%7zu | %-11s | %9.0f | %9.1f%% | %.4f\n", t, mode == perceptron::SYNCHRONOUS ? "synchronous" : "hogwild",
+                        rate, 100.0 * rate / (baseline * t), loss);
+
+            //Unlocked updates may lose some writes, but must still train about as well as the synchronous run
+            if(mode == perceptron::SYNCHRONOUS) {
+                syncLoss = loss;
+            } else {
+                trains = trains && loss < startLoss && loss < syncLoss * HOGWILD_TOLERANCE;
+            }
+        }
+    }
+    std::cout << (trains ? "PASS" : "FAIL") << ": HOGWILD training lowers the loss, within " << HOGWILD_TOLERANCE
+              << "x of synchronous (untrained loss = " << startLoss << ")\n";
+    pass = pass && trains;
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return pass ? 0 : 1;
+}
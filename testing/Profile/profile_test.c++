@@ -0,0 +1,67 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstdio>
+#define PERCEPTRON_PROFILE //Per-layer counters. Every other test builds without them
+#include "../../src/perceptron.h++"
+
+//CONFIGURATION - Change these values
+#define STEPS 10
+
+int main() {
+    std::cout << "Profiling Counters Test\n";
+    std::cout << "=======================\n\n";
+
+    //4 inputs, 8 hidden, 6 hidden, 3 outputs
+    std::vector<size_t> layers = {4, 8, 6, 3};
+    std::vector<perceptron::ACTIVATION_FUNCTION> acts = {perceptron::RELU, perceptron::TANH, perceptron::SIGMOID};
+    perceptron::Perceptron net(layers, acts);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    matrix::Matrix<float> x(4, 5);
+    matrix::Matrix<float> y(3, 5);
+    for(size_t j = 0; j < 5; j++) {
+        for(size_t k = 0; k < 4; k++) {
+            x.at(k, j) = dist(rng);
+        }
+        for(size_t k = 0; k < 3; k++) {
+            y.at(k, j) = 0.5f;
+        }
+    }
+
+    bool pass = true;
+
+    //Every layer should record each forward_batch and backward_batch exactly once
+    net.forward_batch(x);
+    net.reset_profile();
+    for(int step = 0; step < STEPS; step++) {
+        net.train_batch(x, y, 0.01f);
+    }
+
+    bool counted = true;
+    std::cout << "layer | fwd calls |   fwd ns | bwd calls |   bwd ns\n";
+    for(size_t l = 0; l < layers.size() - 1; l++) {
+        const profile::LayerProfile &prof = net.get_profile(l);
+        std::printf("%5zu | %9llu | %8llu | %9llu | %8llu\n", l, (unsigned long long)prof.forward.calls, (unsigned long long)prof.forward.ns,
+                    (unsigned long long)prof.backward.calls, (unsigned long long)prof.backward.ns);
+        counted = counted && prof.forward.calls == STEPS && prof.backward.calls == STEPS && prof.forward.ns > 0 && prof.backward.ns > 0;
+    }
+    std::cout << (counted ? "PASS" : "FAIL") << ": Each layer counted " << STEPS << " forward and " << STEPS << " backward calls\n";
+    pass = pass && counted;
+
+    //Single sample forward goes through the same layers
+    std::vector<float> sample = {0.1f, 0.2f, 0.3f, 0.4f};
+    net.forward(sample);
+    bool single = net.get_profile(0).forward.calls == STEPS + 1;
+    std::cout << (single ? "PASS" : "FAIL") << ": Single sample forward counted\n";
+    pass = pass && single;
+
+    net.reset_profile();
+    bool reset = net.get_profile(0).forward.calls == 0 && net.get_profile(2).backward.ns == 0;
+    std::cout << (reset ? "PASS" : "FAIL") << ": reset_profile zeroes the counters\n";
+    pass = pass && reset;
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
@@ -1,7 +1,12 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include "../../src/perceptron.h++"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include "../../src/inference.h++"
+#include "../../src/quantized.h++"
 
 int main() {
     std::cout << "Save/Load Test\n";
@@ -30,7 +35,7 @@ int main() {
     
     //Save to file
     std::cout << "Saving to file...\n";
-    if(netA.save_file("./Save_load/test_model.net")) {
+    if(netA.save_file("./Save_load/test_model.bin")) {
         std::cout << "Save successful\n\n";
 
     } else {
@@ -49,7 +54,7 @@ int main() {
     
     //Load into netB - should overwrite architecture
     std::cout << "Loading from file...\n";
-    if(netB.read_file("./Save_load/test_model.net")) {
+    if(netB.read_file("./Save_load/test_model.bin")) {
         std::cout << "Load successful\n\n";
     } else {
         std::cout << "Load FAILED\n";
@@ -63,14 +68,117 @@ int main() {
     float outputAfter = netB.forward(testInput)[0];
     std::cout << "Output for [1,0] after load: " << outputAfter << "\n\n";
     
-    //Compare
+    //Compare. Binary files store raw floats, so the match is exact
     float diff = std::abs(outputBefore - outputAfter);
-    if(diff < 0.0001f) {
+    if(diff == 0.0f) {
         std::cout << "PASS: Outputs match (diff = " << diff << ")\n";
     } else {
 
         std::cout << "FAIL: Outputs don't match (diff = " << diff << ")\n";
     }
+
+    //Zero copy inference straight from the mapped file
+    std::cout << "\nMapping file for inference...\n";
+    perceptron::MappedPerceptron mapped;
+    if(!mapped.open("./Save_load/test_model.bin")) {
+        std::cout << "Map FAILED\n";
+        return 1;
+    }
+    float outputMapped = mapped.forward(testInput)[0];
+    diff = std::abs(outputBefore - outputMapped);
+    if(diff < 0.000001f) {
+        std::cout << "PASS: Mapped output matches (diff = " << diff << ")\n";
+    } else {
+        std::cout << "FAIL: Mapped output doesn't match (diff = " << diff << ")\n";
+    }
+
+    //Older text models still load, and can be migrated by saving again
+    std::cout << "\nMigrating text model...\n";
+    perceptron::Perceptron netText(layers, acts);
+    perceptron::Perceptron netMigrated(layers, acts);
+
+    auto startText = std::chrono::steady_clock::now();
+    bool textLoaded = netText.read_file("./Save_load/test_model.net");
+    auto endText = std::chrono::steady_clock::now();
+
+    if(!textLoaded || !netText.save_file("./Save_load/test_model_migrated.bin")) {
+        std::cout << "Migration FAILED\n";
+        return 1;
+    }
+
+    auto startBinary = std::chrono::steady_clock::now();
+    bool binaryLoaded = netMigrated.read_file("./Save_load/test_model_migrated.bin");
+    auto endBinary = std::chrono::steady_clock::now();
+
+    if(!binaryLoaded) {
+        std::cout << "Migration FAILED\n";
+        return 1;
+    }
+    std::cout << "Text load: " << std::chrono::duration<double, std::micro>(endText - startText).count() << "us, "
+              << "binary load: " << std::chrono::duration<double, std::micro>(endBinary - startBinary).count() << "us\n";
+
+    diff = std::abs(netText.forward(testInput)[0] - netMigrated.forward(testInput)[0]);
+    if(diff == 0.0f) {
+        std::cout << "PASS: Migrated outputs match (diff = " << diff << ")\n";
+    } else {
+        std::cout << "FAIL: Migrated outputs don't match (diff = " << diff << ")\n";
+    }
+
+    //int8 models save to their own file and map back bit for bit
+    std::cout << "\nSaving int8 model...\n";
+    perceptron::QuantizedModel quantized(netA);
+    perceptron::QuantizedModel quantizedLoaded;
+    if(!quantized.save_file("./Save_load/test_model_int8.bin") || !quantizedLoaded.open("./Save_load/test_model_int8.bin")) {
+        std::cout << "int8 save/load FAILED\n";
+        return 1;
+    }
+
+    perceptron::QuantizedWorkspace ws(quantized);
+    float outputInt8 = quantized.forward(testInput, ws)[0];
+    float outputInt8Loaded = quantizedLoaded.forward(testInput, ws)[0];
+    diff = std::abs(outputInt8 - outputInt8Loaded);
+    if(diff == 0.0f) {
+        std::cout << "PASS: int8 outputs match after load (diff = " << diff << ")\n";
+    } else {
+        std::cout << "FAIL: int8 outputs don't match after load (diff = " << diff << ")\n";
+    }
+    std::cout << "int8 output " << outputInt8 << " vs fp32 " << outputBefore << "\n";
+
+    //Each file type only loads into the model made for it
+    if(!netMigrated.read_file("./Save_load/test_model_int8.bin") && !quantizedLoaded.open("./Save_load/test_model.bin")) {
+        std::cout << "PASS: int8 and fp32 files are told apart\n";
+    } else {
+        std::cout << "FAIL: Loaded a model file of the wrong type\n";
+    }
+
+    //A header claiming a 2^32 x 2^32 layer must be refused, not read past the end of the mapping
+    std::ifstream original("./Save_load/test_model.bin", std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+    original.close();
+    uint32_t one = 1, huge = UINT32_MAX;
+    std::memcpy(bytes.data() + 8, &one, 4); //Layer count
+    std::memcpy(bytes.data() + modelfile::HEADER_SIZE, &huge, 4); //Rows
+    std::memcpy(bytes.data() + modelfile::HEADER_SIZE + 4, &huge, 4); //Cols
+    std::ofstream oversized("./Save_load/test_model_oversized.bin", std::ios::binary | std::ios::trunc);
+    oversized.write(bytes.data(), bytes.size());
+    oversized.close();
+
+    perceptron::InferenceModel oversizedModel;
+    if(!netMigrated.read_file("./Save_load/test_model_oversized.bin") && !oversizedModel.open("./Save_load/test_model_oversized.bin") &&
+       !quantizedLoaded.open("./Save_load/test_model_oversized.bin")) {
+        std::cout << "PASS: Oversized layer header rejected\n";
+    } else {
+        std::cout << "FAIL: Loaded a file with an oversized layer header\n";
+    }
+
+    //Dimensions that don't fit the 32 bit header fields are refused instead of truncated
+    float unused = 0.0f;
+    modelfile::LayerBlocks tooWide = {(size_t)UINT32_MAX + 1, 1, 0, {{&unused, 0}}};
+    if(!modelfile::write_blocks("./Save_load/test_model_too_wide.bin", 0, {tooWide})) {
+        std::cout << "PASS: Layer wider than 2^32 - 1 not written\n";
+    } else {
+        std::cout << "FAIL: Wrote a layer wider than 2^32 - 1\n";
+    }
     
     return 0;
 }
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include "../../src/static_perceptron.h++"
+
+//CONFIGURATION - Change these values
+#define CALLS 1000000 //Forward passes per latency measurement
+
+using namespace perceptron;
+
+typedef StaticPerceptron<Topology<2, 4, 1>, Activations<TANH, SIGMOID>> XorNet;
+typedef StaticPerceptron<Topology<4, 8, 6, 3>, Activations<RELU, TANH, SIGMOID>> DeepNet;
+typedef StaticPerceptron<Topology<4, 6, 3>, Activations<RELU, SIGMOID>> IrisNet;
+
+
+//Largest difference between a static and a dynamic network on the same input
+template <typename Net>
+float max_diff(Net &fixedNet, Perceptron &net, std::vector<float> &x) {
+    const typename Net::Output &a = fixedNet.forward(x.data());
+    const std::vector<float> &b = net.forward(x);
+    float diff = 0.0f;
+    for(size_t i = 0; i < b.size(); i++) {
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+    }
+    return diff;
+}
+
+
+int main() {
+    std::cout << "Static Perceptron Test\n";
+    std::cout << "======================\n\n";
+
+    bool pass = true;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    //XOR on a 2-4-1 network, same setup as the XOR test
+    std::cout << "Training XOR...\n";
+    XorNet xorNet;
+    std::vector<XorNet::Input> inputs = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    std::vector<XorNet::Output> targets = {{0}, {1}, {1}, {0}};
+    xorNet.train(inputs, targets, 5000, 0.5f, false);
+
+    for(size_t i = 0; i < inputs.size(); i++) {
+        float o = xorNet.forward(inputs[i])[0];
+        int pred = (o > 0.5f) ? 1 : 0;
+        std::cout << inputs[i][0] << " XOR " << inputs[i][1] << " = " << o;
+        if(pred == targets[i][0]) {
+            std::cout << " PASS\n";
+        } else {
+            std::cout << " FAIL\n";
+            pass = false;
+        }
+    }
+    std::cout << "\n";
+
+    //Perceptron -> StaticPerceptron through the shared file format
+    std::vector<size_t> layers = {4, 8, 6, 3};
+    std::vector<ACTIVATION_FUNCTION> acts = {RELU, TANH, SIGMOID};
+    Perceptron net(layers, acts);
+    DeepNet deepNet;
+
+    std::vector<float> x(4);
+    for(float &v : x) {
+        v = dist(rng);
+    }
+
+    bool loaded = net.save_file("./Static/static_model.bin") && deepNet.read_file("./Static/static_model.bin");
+    float diff = max_diff(deepNet, net, x);
+    bool ok = loaded && diff < 1e-6f;
+    std::cout << (ok ? "PASS" : "FAIL") << ": Perceptron file loads into StaticPerceptron (max diff = " << diff << ")\n";
+    pass = pass && ok;
+
+    //One SGD step on both from the same weights
+    std::vector<float> y = {0.0f, 1.0f, 0.0f};
+    DeepNet::Output yFixed = {0.0f, 1.0f, 0.0f};
+    net.forward(x);
+    net.backward(y, 0.1f);
+    deepNet.forward(x.data());
+    deepNet.backward(yFixed, 0.1f);
+
+    for(float &v : x) {
+        v = dist(rng);
+    }
+    diff = max_diff(deepNet, net, x);
+    ok = diff < 1e-5f;
+    std::cout << (ok ? "PASS" : "FAIL") << ": Backward step matches Perceptron (max diff = " << diff << ")\n";
+    pass = pass && ok;
+
+    //StaticPerceptron -> Perceptron
+    Perceptron copy(layers, acts);
+    loaded = deepNet.save_file("./Static/static_model.bin") && copy.read_file("./Static/static_model.bin");
+    diff = max_diff(deepNet, copy, x);
+    ok = loaded && diff < 1e-6f;
+    std::cout << (ok ? "PASS" : "FAIL") << ": StaticPerceptron file loads into Perceptron (max diff = " << diff << ")\n";
+    pass = pass && ok;
+
+    //A file with another topology or activations must be refused
+    IrisNet irisNet;
+    StaticPerceptron<Topology<4, 8, 6, 3>, Activations<RELU, RELU, SIGMOID>> wrongActs;
+    ok = !irisNet.read_file("./Static/static_model.bin") && !wrongActs.read_file("./Static/static_model.bin");
+    std::cout << (ok ? "PASS" : "FAIL") << ": Mismatched topology and activations are rejected\n\n";
+    pass = pass && ok;
+    std::remove("./Static/static_model.bin");
+
+    //Latency on an IRIS sized network
+    std::vector<size_t> irisLayers = {4, 6, 3};
+    std::vector<ACTIVATION_FUNCTION> irisActs = {RELU, SIGMOID};
+    Perceptron irisDynamic(irisLayers, irisActs);
+
+    std::vector<std::vector<float>> samples(64, std::vector<float>(4));
+    for(std::vector<float> &sample : samples) {
+        for(float &v : sample) {
+            v = dist(rng);
+        }
+    }
+
+    float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < CALLS; i++) {
+        sink += irisDynamic.forward(samples[i % samples.size()])[0];
+    }
+    auto end = std::chrono::steady_clock::now();
+    double dynamicNs = std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < CALLS; i++) {
+        sink += irisNet.forward(samples[i % samples.size()].data())[0];
+    }
+    end = std::chrono::steady_clock::now();
+    double staticNs = std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+
+    std::cout << "4-6-3 forward (" << CALLS << " calls):\n";
+    std::printf("  Perceptron:       %8.1f ns\n", dynamicNs);
+    std::printf("  StaticPerceptron: %8.1f ns (%.1fx)\n", staticNs, dynamicNs / staticNs);
+    std::cout << "  StaticPerceptron size: " << IrisNet::bytes() << " bytes, no heap\n";
+    std::cout << "  (checksum " << sink << ")\n";
+
+    std::cout << (pass ? "\nPASS\n" : "\nFAIL\n");
+    return 0;
+}
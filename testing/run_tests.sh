@@ -9,6 +9,7 @@ NC='\033[0m' # No Color
 
 BIN_DIR="../bin"
 TEST_DIR="."
+CXX="${CXX:-clang++}" #Override with CXX=g++ ./run_tests.sh compile
 
 mkdir -p $BIN_DIR
 
@@ -32,7 +33,7 @@ compile_test() {
         return 1
     fi
     
-    clang++ -std=c++17 -O3 "$source" -o "$BIN_DIR/$name"
+    $CXX -std=c++17 -O3 -pthread "$source" -o "$BIN_DIR/$name"
     
     if [ $? -eq 0 ]; then
         echo -e "${GREEN}$name done${NC}"
@@ -65,6 +66,13 @@ compile_all() {
     compile_test "save_load_test" "$TEST_DIR/Save_load/save_load_test.c++"
     compile_test "iris_test" "$TEST_DIR/IRIS/test_iris.c++"
     compile_test "mnist_test" "$TEST_DIR/MNIST/test_mnist.c++"
+    compile_test "batch_test" "$TEST_DIR/Batch/batch_test.c++"
+    compile_test "gemm_test" "$TEST_DIR/GEMM/gemm_test.c++"
+    compile_test "parallel_test" "$TEST_DIR/Parallel/parallel_test.c++"
+    compile_test "inference_test" "$TEST_DIR/Inference/inference_test.c++"
+    compile_test "static_test" "$TEST_DIR/Static/static_test.c++"
+    compile_test "profile_test" "$TEST_DIR/Profile/profile_test.c++"
+    compile_test "benchmark" "$TEST_DIR/Benchmark/benchmark.c++"
     
     echo "================================"
     echo -e "${GREEN}compile complete${NC}"
@@ -79,6 +87,13 @@ run_all() {
     run_test "save_load_test"
     run_test "iris_test"
     run_test "mnist_test"
+    run_test "batch_test"
+    run_test "gemm_test"
+    run_test "parallel_test"
+    run_test "inference_test"
+    run_test "static_test"
+    run_test "profile_test"
+    run_test "benchmark"
     
     echo "================================"
     echo -e "${GREEN}testing complete${NC}"
@@ -99,8 +114,29 @@ run_single() {
         mnist)
             run_test "mnist_test"
             ;;
+        batch)
+            run_test "batch_test"
+            ;;
+        gemm)
+            run_test "gemm_test"
+            ;;
+        parallel)
+            run_test "parallel_test"
+            ;;
+        inference)
+            run_test "inference_test"
+            ;;
+        benchmark)
+            run_test "benchmark"
+            ;;
+        static)
+            run_test "static_test"
+            ;;
+        profile)
+            run_test "profile_test"
+            ;;
         *)
-            echo "options: xor, save, iris, mnist"
+            echo "options: xor, save, iris, mnist, batch, gemm, parallel, inference, static, profile, benchmark"
             ;;
     esac
 }
@@ -120,11 +156,25 @@ usage() {
     echo "  compile-save         - compile Save/Load test only"
     echo "  compile-iris         - compile Iris test only"
     echo "  compile-mnist        - compile MNIST test only"
+    echo "  compile-batch        - compile mini-batch test only"
+    echo "  compile-gemm         - compile GEMM test only"
+    echo "  compile-parallel     - compile parallel training test only"
+    echo "  compile-inference    - compile inference engine test only"
+    echo "  compile-benchmark    - compile benchmark only"
+    echo "  compile-static       - compile static perceptron test only"
+    echo "  compile-profile      - compile profiling counters test only"
     echo "  run                  - run all tests"
     echo "  run-xor              - run XOR test"
     echo "  run-save             - run Save/Load test"
     echo "  run-iris             - run Iris test"
     echo "  run-mnist            - run MNIST test"
+    echo "  run-batch            - run mini-batch test"
+    echo "  run-gemm             - run GEMM test"
+    echo "  run-parallel         - run parallel training test"
+    echo "  run-inference        - run inference engine test"
+    echo "  run-benchmark        - run benchmark (writes Benchmark/benchmark.json)"
+    echo "  run-static           - run static perceptron test"
+    echo "  run-profile          - run profiling counters test"
     echo "  clean                - remove compiled binaries"
     echo "  help                 - show this message"
 }
@@ -146,6 +196,27 @@ case "$1" in
     compile-mnist)
         compile_test "mnist_test" "$TEST_DIR/MNIST/test_mnist.c++"
         ;;
+    compile-batch)
+        compile_test "batch_test" "$TEST_DIR/Batch/batch_test.c++"
+        ;;
+    compile-gemm)
+        compile_test "gemm_test" "$TEST_DIR/GEMM/gemm_test.c++"
+        ;;
+    compile-parallel)
+        compile_test "parallel_test" "$TEST_DIR/Parallel/parallel_test.c++"
+        ;;
+    compile-inference)
+        compile_test "inference_test" "$TEST_DIR/Inference/inference_test.c++"
+        ;;
+    compile-benchmark)
+        compile_test "benchmark" "$TEST_DIR/Benchmark/benchmark.c++"
+        ;;
+    compile-static)
+        compile_test "static_test" "$TEST_DIR/Static/static_test.c++"
+        ;;
+    compile-profile)
+        compile_test "profile_test" "$TEST_DIR/Profile/profile_test.c++"
+        ;;
     run)
         run_all
         ;;
@@ -161,6 +232,27 @@ case "$1" in
     run-mnist)
         run_single "mnist"
         ;;
+    run-batch)
+        run_single "batch"
+        ;;
+    run-gemm)
+        run_single "gemm"
+        ;;
+    run-parallel)
+        run_single "parallel"
+        ;;
+    run-inference)
+        run_single "inference"
+        ;;
+    run-benchmark)
+        run_single "benchmark"
+        ;;
+    run-static)
+        run_single "static"
+        ;;
+    run-profile)
+        run_single "profile"
+        ;;
     clean)
         clean
         ;;